@@ -0,0 +1,548 @@
+// Headless DMA microbenchmarks, built and run by `make bench` against the Rack stub in
+// this directory. The module sources are compiled in whole, so the hosts and clients
+// measured here are the real ones. Each figure is the best of several timed runs.
+#include "../src/RAM40964.cpp"
+#include "../src/Microcosm.cpp"
+#include "../src/Integrator.cpp"
+#include "../src/DMAFX.cpp"
+#include "../src/Accessor.cpp"
+#include "../src/SparseRAM.cpp"
+#include "../src/DMABridge.cpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+Plugin* pluginInstance;
+int rack::settings::threadCount = 1;
+
+namespace {
+
+	typedef std::chrono::steady_clock Clock;
+
+	const char *filter = nullptr;
+	volatile float sink_float;
+	volatile bool sink_bool;
+	int failures = 0;
+
+	// Times func, which does ops operations moving bytes bytes per call, and prints ns/op and throughput.
+	template <typename F>
+	void bench(const char *name, double ops, double bytes, F func) {
+		if (filter && !std::strstr(name, filter))
+			return;
+		long calls = 1;
+		for (;;) {
+			Clock::time_point start = Clock::now();
+			for (long i=0; i<calls; ++i)
+				func();
+			if (Clock::now() - start > std::chrono::milliseconds(20))
+				break;
+			calls *= 2;
+		}
+		double best = 1e30;
+		for (int run=0; run<5; ++run) {
+			Clock::time_point start = Clock::now();
+			for (long i=0; i<calls; ++i)
+				func();
+			best = std::min(best, std::chrono::duration<double, std::nano>(Clock::now() - start).count() / calls);
+		}
+		double ns_per_op = best / ops;
+		if (bytes > 0.0)
+			std::printf("%-40s %10.2f ns/op %10.1f Mop/s %10.1f MB/s\n", name, ns_per_op, 1e3 / ns_per_op, bytes * 1e3 / best);
+		else
+			std::printf("%-40s %10.2f ns/op %10.1f Mop/s\n", name, ns_per_op, 1e3 / ns_per_op);
+	}
+
+	// Prints a correctness check alongside the timings and counts it towards the exit status.
+	void check(const char *name, bool ok) {
+		if (filter && !std::strstr(name, filter))
+			return;
+		std::printf("%-40s %10s\n", name, ok ? "ok" : "FAILED");
+		if (!ok)
+			++failures;
+	}
+
+	void connect(Module *client, Module *host) {
+		client->rightExpander.module = host;
+		host->leftExpander.module = client;
+		Module::ExpanderChangeEvent e;
+		e.side = 1;
+		client->onExpanderChange(e);
+		e.side = 0;
+		host->onExpanderChange(e);
+	}
+
+	struct Frame {
+		Module::ProcessArgs args;
+
+		const Module::ProcessArgs &next() {
+			++args.frame;
+			return args;
+		}
+	};
+
+	void fillAddresses(int *addresses, int n, int count) {
+		for (int i=0; i<n; ++i)
+			addresses[i] = (i * 257) % count;
+	}
+
+	void benchRAM40964() {
+		static RAM40964 ram;
+		DMAChannel<float> &dma = *ram.getDMAChannel(0);
+		const std::size_t count = dma.size();
+		std::vector<float> values(count, 1.f);
+		int addresses[PORT_MAX_CHANNELS];
+		float gathered[PORT_MAX_CHANNELS] = {};
+		fillAddresses(addresses, PORT_MAX_CHANNELS, (int)count);
+
+		bench("RAM40964 read", count, 0, [&]() {
+			float sum = 0.f;
+			for (std::size_t i=0; i<count; ++i)
+				sum += dma.read(i);
+			sink_float = sum;
+		});
+		bench("RAM40964 write", count, 0, [&]() {
+			for (std::size_t i=0; i<count; ++i)
+				dma.write(i, (float)i);
+		});
+		bench("RAM40964 readAll", count, count * sizeof(float), [&]() {
+			dma.readAll(values.data());
+			sink_float = values[0];
+		});
+		bench("RAM40964 writeAll", count, count * sizeof(float), [&]() {
+			dma.writeAll(values.data());
+		});
+		bench("RAM40964 gather x16", PORT_MAX_CHANNELS, 0, [&]() {
+			dma.readGather(addresses, PORT_MAX_CHANNELS, gathered);
+			sink_float = gathered[0];
+		});
+		bench("RAM40964 scatter x16", PORT_MAX_CHANNELS, 0, [&]() {
+			dma.writeScatter(addresses, PORT_MAX_CHANNELS, gathered);
+		});
+
+		DMAScratch<float> scratch;
+		DMATransform scroll(DMATransform::SCROLL);
+		scroll.dx = 3;
+		scroll.dy = -2;
+		scroll.wrap = true;
+		DMATransform invert(DMATransform::INVERT);
+		invert.offset = 10.f;
+		bench("RAM40964 scroll (cells)", count, 0, [&]() { applyDMATransform(dma, scroll, scratch); });
+		bench("RAM40964 flip V (cells)", count, 0, [&]() { applyDMATransform(dma, DMATransform(DMATransform::FLIP_V), scratch); });
+		bench("RAM40964 flip H (cells)", count, 0, [&]() { applyDMATransform(dma, DMATransform(DMATransform::FLIP_H), scratch); });
+		bench("RAM40964 rotate CW (cells)", count, 0, [&]() { applyDMATransform(dma, DMATransform(DMATransform::ROTATE_CW), scratch); });
+		bench("RAM40964 invert (cells)", count, 0, [&]() { applyDMATransform(dma, invert, scratch); });
+
+		// The same scatter, queued by a client and applied by the host
+		static Accessor accessor;
+		connect(&accessor, &ram);
+		Frame frame;
+		DMACommand<float> command;
+		command.type = DMACommand<float>::WRITE;
+		command.channel = accessor.DMAClient<float>::getDMAChannel(0);
+		command.count = PORT_MAX_CHANNELS;
+		std::copy(addresses, addresses + PORT_MAX_CHANNELS, command.addresses);
+		std::fill(command.values, command.values + PORT_MAX_CHANNELS, 5.f);
+		bench("RAM40964 queued scatter x16", PORT_MAX_CHANNELS, 0, [&]() {
+			accessor.process(frame.next());
+			accessor.submitDMACommand(command);
+			ram.dma_queue.apply(frame.args.frame + 1, ram.getDMAGeneration());
+		});
+		bench("RAM40964 process", 1, 0, [&]() {
+			ram.process(frame.next());
+		});
+
+		// Patch save and load with memory contents, per cell
+		std::size_t cells = RAM40964::PLANE_COUNT * count;
+		ram.save_memory = true;
+		for (int half=0; half<2; ++half) {
+			ram.save_float16 = half;
+			json_t *root = ram.dataToJson();
+			bench(half ? "RAM40964 save float16 (cells)" : "RAM40964 save float32 (cells)", cells, 0, [&]() {
+				ram.markAllChanged();
+				json_decref(ram.dataToJson());
+			});
+			bench(half ? "RAM40964 save float16 clean (cells)" : "RAM40964 save float32 clean (cells)", cells, 0, [&]() {
+				json_decref(ram.dataToJson());
+			});
+			bench(half ? "RAM40964 save float16 1 row (cells)" : "RAM40964 save float32 1 row (cells)", cells, 0, [&]() {
+				ram.dma[0].markDMAChanged(0);
+				json_decref(ram.dataToJson());
+			});
+			bench(half ? "RAM40964 load float16 (cells)" : "RAM40964 load float32 (cells)", cells, 0, [&]() {
+				ram.dataFromJson(root);
+			});
+			json_decref(root);
+		}
+		ram.save_memory = false;
+	}
+
+	// The other RAM sizes and layouts, for how each scales with the matrix and its downsampled display.
+	template <typename TRAM>
+	void benchRAMSize(const char *name) {
+		static TRAM ram;
+		DMAChannel<float> &dma = *ram.getDMAChannel(0);
+		DMAScratch<float> scratch;
+		Frame frame;
+		char label[64];
+		std::snprintf(label, sizeof(label), "%s process", name);
+		bench(label, 1, 0, [&]() {
+			ram.process(frame.next());
+		});
+		// A full refresh is spread over a sweep of samples by the light budget.
+		std::snprintf(label, sizeof(label), "%s display refresh (lights)", name);
+		ram.fade_lights = false;
+		bench(label, TRAM::DISPLAY_WIDTH * TRAM::DISPLAY_HEIGHT, 0, [&]() {
+			ram.markLightsDirty(0, 0, TRAM::MATRIX_WIDTH, TRAM::MATRIX_HEIGHT);
+			for (int i=0; i<TRAM::SWEEP_FRAMES; ++i)
+				ram.refreshDirtyLights(frame.next().frame, 1.f / 48000.f);
+		});
+		ram.fade_lights = true;
+		std::snprintf(label, sizeof(label), "%s process, writing 16 cells", name);
+		ram.params[TRAM::WRITE_PARAM].setValue(1.f);
+		ram.inputs[TRAM::XW_INPUT].setChannels(PORT_MAX_CHANNELS);
+		for (int c=0; c<PORT_MAX_CHANNELS; ++c)
+			ram.inputs[TRAM::XW_INPUT].setVoltage(10.f * c / PORT_MAX_CHANNELS, c);
+		bench(label, 1, 0, [&]() {
+			ram.process(frame.next());
+		});
+		ram.inputs[TRAM::XW_INPUT].setChannels(0);
+		ram.params[TRAM::WRITE_PARAM].setValue(0.f);
+		std::snprintf(label, sizeof(label), "%s flip V (cells)", name);
+		bench(label, dma.size(), 0, [&]() {
+			applyDMATransform(dma, DMATransform(DMATransform::FLIP_V), scratch);
+		});
+		DMATransform scroll(DMATransform::SCROLL);
+		scroll.dx = 3;
+		scroll.dy = 1;
+		scroll.wrap = true;
+		std::snprintf(label, sizeof(label), "%s scroll (cells)", name);
+		bench(label, dma.size(), 0, [&]() {
+			applyDMATransform(dma, scroll, scratch);
+		});
+		DMATransform invert(DMATransform::INVERT);
+		std::snprintf(label, sizeof(label), "%s invert (cells)", name);
+		bench(label, dma.size(), 0, [&]() {
+			applyDMATransform(dma, invert, scratch);
+		});
+		std::vector<float> values(dma.size());
+		std::snprintf(label, sizeof(label), "%s readAll", name);
+		bench(label, dma.size(), dma.size() * sizeof(float), [&]() {
+			dma.readBlock(0, dma.size(), values.data());
+			sink_float = values[0];
+		});
+	}
+
+	void benchRAMSizes() {
+		benchRAMSize<RAM<16, 16>>("RAM2564");
+		benchRAMSize<RAM<64, 64>>("RAM40964");
+		benchRAMSize<RAM<64, 64, false>>("RAM40964 interleaved");
+		benchRAMSize<RAM<256, 256>>("RAM655364");
+	}
+
+	void benchAccessor() {
+		static RAM40964 ram;
+		static Accessor accessor;
+		connect(&accessor, &ram);
+		Frame frame;
+		for (int i=0; i<PORT_MAX_CHANNELS; ++i) {
+			accessor.inputs[Accessor::X_INPUT].setVoltage(i * 0.6f, i);
+			accessor.inputs[Accessor::Y_INPUT].setVoltage(i * 0.3f, i);
+			accessor.inputs[Accessor::WRITE_INPUT].setVoltage(10.f, i);
+		}
+		accessor.inputs[Accessor::X_INPUT].setChannels(PORT_MAX_CHANNELS);
+		accessor.inputs[Accessor::Y_INPUT].setChannels(PORT_MAX_CHANNELS);
+		accessor.inputs[Accessor::WRITE_INPUT].setChannels(PORT_MAX_CHANNELS);
+		bench("Accessor+RAM40964 process x16 voices", PORT_MAX_CHANNELS, 0, [&]() {
+			const Module::ProcessArgs &args = frame.next();
+			accessor.process(args);
+			ram.process(args);
+		});
+	}
+
+	// Rack tells the host when a client is removed, then deletes it. A READ the client
+	// queued just before must not land in its freed memory.
+	void benchClientRemoval() {
+		static RAM40964 ram;
+		settings::threadCount = 2; // With one thread the Accessor reads directly
+		alignas(Accessor) static unsigned char storage[sizeof(Accessor)];
+		Accessor *accessor = new (storage) Accessor;
+		connect(accessor, &ram);
+		Frame frame;
+		ram.cell(0, 0) = 3.25f;
+		accessor->process(frame.next());
+		accessor->rightExpander.module = nullptr;
+		ram.leftExpander.module = nullptr;
+		Module::ExpanderChangeEvent e;
+		e.side = 0;
+		ram.onExpanderChange(e);
+		accessor->~Accessor();
+		std::memset(storage, 0x5a, sizeof(storage));
+		ram.process(frame.next());
+		settings::threadCount = 1;
+		check("READ of a removed client dropped", std::all_of(storage, storage + sizeof(storage), [](unsigned char b) {
+			return b == 0x5a;
+		}));
+	}
+
+	void benchDMAFX() {
+		static RAM40964 ram;
+		static DMAFX fx;
+		connect(&fx, &ram);
+		Frame frame;
+		std::size_t cells = RAM40964::PLANE_COUNT * RAM40964::MATRIX_WIDTH * RAM40964::MATRIX_HEIGHT;
+		fx.inputs[DMAFX::FLIP_V_INPUT].setChannels(1);
+		bool high = false;
+		// Two samples per call: the trigger rises on one of them
+		bench("DMAFX+RAM40964 flip V all planes (cells)", cells, 0, [&]() {
+			for (int i=0; i<2; ++i) {
+				high = !high;
+				fx.inputs[DMAFX::FLIP_V_INPUT].setVoltage(high ? 10.f : 0.f);
+				const Module::ProcessArgs &args = frame.next();
+				fx.process(args);
+				ram.process(args);
+			}
+		});
+		fx.parallel = true;
+		bench("DMAFX+RAM40964 flip V parallel (cells)", cells, 0, [&]() {
+			for (int i=0; i<2; ++i) {
+				high = !high;
+				fx.inputs[DMAFX::FLIP_V_INPUT].setVoltage(high ? 10.f : 0.f);
+				const Module::ProcessArgs &args = frame.next();
+				fx.process(args);
+				ram.process(args);
+			}
+		});
+		fx.parallel = false;
+	}
+
+	void benchBits() {
+		static Microcosm microcosm;
+		DMAChannel<bool> &field = *microcosm.getDMAChannel(0);
+		std::size_t count = field.size();
+		bench("Microcosm read", count, 0, [&]() {
+			bool any = false;
+			for (std::size_t i=0; i<count; ++i)
+				any ^= field.read(i);
+			sink_bool = any;
+		});
+		bench("Microcosm write", count, 0, [&]() {
+			for (std::size_t i=0; i<count; ++i)
+				field.write(i, i & 1);
+		});
+		DMAScratch<bool> scratch;
+		bench("Microcosm invert (cells)", count, 0, [&]() { applyDMATransform(field, DMATransform(DMATransform::INVERT), scratch); });
+
+		// A larger bit channel, where word-at-a-time operations pay off
+		const std::size_t size = 256;
+		static std::vector<uint64_t> words(DMABitChannel::wordsPerRow(size) * size);
+		static DMABitChannel bits;
+		bits.setup(nullptr, size, size, words.data());
+		DMATransform scroll(DMATransform::SCROLL);
+		scroll.dx = 5;
+		scroll.dy = 1;
+		scroll.wrap = true;
+		DMATransform randomize(DMATransform::RANDOMIZE);
+		bench("bits 256x256 scroll (cells)", size * size, 0, [&]() { applyDMATransform<bool>(bits, scroll, scratch); });
+		bench("bits 256x256 flip H (cells)", size * size, 0, [&]() { applyDMATransform<bool>(bits, DMATransform(DMATransform::FLIP_H), scratch); });
+		bench("bits 256x256 rotate CW (cells)", size * size, 0, [&]() { applyDMATransform<bool>(bits, DMATransform(DMATransform::ROTATE_CW), scratch); });
+		bench("bits 256x256 randomize (cells)", size * size, 0, [&]() { applyDMATransform<bool>(bits, randomize, scratch); });
+	}
+
+	struct SparseHost : DMAHost<float> {
+		DMASparseChannel<float> dma;
+		int getDMAChannelCount() const override { return 1; }
+		DMAChannel<float> *getDMAChannel(int num) override { return &dma; }
+	};
+
+	void benchSparse() {
+		const std::size_t size = 1024;
+		static SparseHost host;
+		host.dma.setup(&host, size, size);
+		for (std::size_t i=0; i<size*size; i+=size*97)
+			host.dma.write(i, 1.f); // A handful of populated pages
+		int addresses[PORT_MAX_CHANNELS];
+		float gathered[PORT_MAX_CHANNELS] = {};
+		fillAddresses(addresses, PORT_MAX_CHANNELS, (int)(size * size));
+		std::vector<float> values(size * size);
+		DMAScratch<float> scratch;
+		bench("sparse 1024x1024 gather x16", PORT_MAX_CHANNELS, 0, [&]() {
+			host.dma.readGather(addresses, PORT_MAX_CHANNELS, gathered);
+			sink_float = gathered[0];
+		});
+		bench("sparse 1024x1024 readAll", size * size, size * size * sizeof(float), [&]() {
+			host.dma.readAll(values.data());
+			sink_float = values[0];
+		});
+		bench("sparse 1024x1024 invert (cells)", size * size, 0, [&]() {
+			applyDMATransform<float>(host.dma, DMATransform(DMATransform::INVERT), scratch);
+		});
+		const char *name = "sparse 1024x1024 populated";
+		if (!filter || std::strstr(name, filter))
+			std::printf("%-40s %10zu pages %10zu KB\n", name, host.dma.getPopulatedPageCount(), host.dma.getMemoryUsage() / 1024);
+
+		// The same kind of memory behind a module, written through its queue
+		static SparseRAM ram;
+		static Accessor accessor;
+		connect(&accessor, &ram);
+		Frame frame;
+		for (int i=0; i<PORT_MAX_CHANNELS; ++i) {
+			accessor.inputs[Accessor::X_INPUT].setVoltage(i * 0.6f, i);
+			accessor.inputs[Accessor::Y_INPUT].setVoltage(i * 0.3f, i);
+			accessor.inputs[Accessor::WRITE_INPUT].setVoltage(10.f, i);
+		}
+		accessor.inputs[Accessor::X_INPUT].setChannels(PORT_MAX_CHANNELS);
+		accessor.inputs[Accessor::Y_INPUT].setChannels(PORT_MAX_CHANNELS);
+		accessor.inputs[Accessor::WRITE_INPUT].setChannels(PORT_MAX_CHANNELS);
+		bench("Accessor+SparseRAM process x16 voices", PORT_MAX_CHANNELS, 0, [&]() {
+			const Module::ProcessArgs &args = frame.next();
+			accessor.process(args);
+			ram.process(args);
+		});
+	}
+
+	void setBridge(DMABridge &bridge, bool left_to_right, int sx, int sy, int dx, int dy, int width, int height) {
+		bridge.params[DMABridge::DIRECTION_PARAM].setValue(left_to_right ? 0.f : 1.f);
+		bridge.params[DMABridge::SRC_X_PARAM].setValue(sx);
+		bridge.params[DMABridge::SRC_Y_PARAM].setValue(sy);
+		bridge.params[DMABridge::DEST_X_PARAM].setValue(dx);
+		bridge.params[DMABridge::DEST_Y_PARAM].setValue(dy);
+		bridge.params[DMABridge::WIDTH_PARAM].setValue(width);
+		bridge.params[DMABridge::HEIGHT_PARAM].setValue(height);
+	}
+
+	// Presses Copy, after a frame with it released, and runs the bridge and its hosts
+	// until the copy is done.
+	void runBridgeCopy(Module &left, DMABridge &bridge, Module &right, Frame &frame) {
+		for (int n=0; n<100000; ++n) {
+			bridge.params[DMABridge::COPY_PARAM].setValue(n == 1 ? 1.f : 0.f);
+			const Module::ProcessArgs &args = frame.next();
+			left.process(args);
+			bridge.process(args);
+			right.process(args);
+			if (n > 0 && bridge.phase == DMABridge::IDLE && !bridge.copy_pending)
+				break;
+		}
+	}
+
+	void benchBridge() {
+		Frame frame;
+
+		// Float to bool sets cells above 0.5V; bool to float writes 10V
+		static RAM40964 ram;
+		static Microcosm microcosm;
+		static DMABridge bits_bridge;
+		connect(&ram, &bits_bridge);
+		connect(&bits_bridge, &microcosm);
+		DMAChannel<bool> &field = *microcosm.getDMAChannel(0);
+		const float levels[] = {-10.f, 0.f, 0.49f, 0.5f, 0.51f, 1.f, 10.f};
+		for (int i=0; i<Microcosm::CELL_COUNT; ++i) {
+			float v = levels[i % 7];
+			ram.cell(RAM40964::MATRIX_WIDTH * (i / Microcosm::GRID_WIDTH) + i % Microcosm::GRID_WIDTH, 0) = v;
+			field.write(i, !(v > 0.5f));
+		}
+		setBridge(bits_bridge, true, 0, 0, 0, 0, 0, 0);
+		runBridgeCopy(ram, bits_bridge, microcosm, frame);
+		bool ok = true;
+		for (int i=0; i<Microcosm::CELL_COUNT; ++i)
+			ok &= field.read(i) == (levels[i % 7] > 0.5f);
+		check("bridge float to bool threshold", ok);
+		bits_bridge.params[DMABridge::DEST_CHANNEL_PARAM].setValue(1.f);
+		setBridge(bits_bridge, false, 0, 0, 10, 10, 0, 0);
+		runBridgeCopy(ram, bits_bridge, microcosm, frame);
+		ok = true;
+		for (int i=0; i<Microcosm::CELL_COUNT; ++i)
+			ok &= ram.cell(RAM40964::MATRIX_WIDTH * (10 + i / Microcosm::GRID_WIDTH) + 10 + i % Microcosm::GRID_WIDTH, 1) == (field.read(i) ? 10.f : 0.f);
+		check("bridge bool to float 10V", ok);
+
+		// A copy taller than a band, ending part way into the last one
+		const int width = 1000, height = 37;
+		static SparseRAM sparse_src, sparse_dest;
+		static DMABridge band_bridge;
+		connect(&sparse_src, &band_bridge);
+		connect(&band_bridge, &sparse_dest);
+		for (int y=0; y<height+10; ++y)
+			for (int x=0; x<width+10; ++x) {
+				sparse_src.dma.write(SparseRAM::MEMORY_WIDTH * y + x, (float)(x * 7 + y * 13));
+				sparse_dest.dma.write(SparseRAM::MEMORY_WIDTH * y + x, -1.f);
+			}
+		setBridge(band_bridge, true, 3, 5, 2, 4, width, height);
+		runBridgeCopy(sparse_src, band_bridge, sparse_dest, frame);
+		ok = width * height > (int)DMABridge::BAND_CELLS;
+		for (int y=0; y<height+10; ++y)
+			for (int x=0; x<width+10; ++x) {
+				bool inside = x >= 2 && x < 2 + width && y >= 4 && y < 4 + height;
+				float expected = inside ? (float)((x + 1) * 7 + (y + 1) * 13) : -1.f;
+				ok &= sparse_dest.dma.read(SparseRAM::MEMORY_WIDTH * y + x) == expected;
+			}
+		check("bridge copy across band boundaries", ok);
+		bench("DMABridge 1000x37 sparse copy", width * height, width * height * 2 * sizeof(float), [&]() {
+			runBridgeCopy(sparse_src, band_bridge, sparse_dest, frame);
+		});
+
+		// A rectangle running past the source's right and the destination's bottom edge
+		static RAM40964 ram_src, ram_dest;
+		static DMABridge clip_bridge;
+		connect(&ram_src, &clip_bridge);
+		connect(&clip_bridge, &ram_dest);
+		for (int i=0; i<RAM40964::MATRIX_WIDTH*RAM40964::MATRIX_HEIGHT; ++i) {
+			ram_src.cell(i, 0) = (float)i;
+			ram_dest.cell(i, 0) = -1.f;
+		}
+		setBridge(clip_bridge, true, 60, 50, 10, 62, 20, 20);
+		runBridgeCopy(ram_src, clip_bridge, ram_dest, frame);
+		ok = true;
+		for (int y=0; y<RAM40964::MATRIX_HEIGHT; ++y)
+			for (int x=0; x<RAM40964::MATRIX_WIDTH; ++x) {
+				bool inside = x >= 10 && x < 14 && y >= 62;
+				float expected = inside ? (float)(RAM40964::MATRIX_WIDTH * (y - 12) + x + 50) : -1.f;
+				ok &= ram_dest.cell(RAM40964::MATRIX_WIDTH * y + x, 0) == expected;
+			}
+		check("bridge rectangle clipped at the edges", ok);
+	}
+
+	void benchIntegrator() {
+		static RAM40964 ram;
+		static Integrator integrator;
+		static Accessor accessor;
+		connect(&integrator, &ram);
+		connect(&accessor, &integrator);
+		Frame frame;
+		integrator.process(frame.next());
+
+		DMAChannel<float> &own = *accessor.DMAClient<float>::getDMAChannel(0);
+		DMAChannel<float> &passed = *accessor.DMAClient<float>::getDMAChannel(1);
+		std::size_t count = passed.size();
+		bench("Integrator own channel read", own.size(), 0, [&]() {
+			sink_float = own.read(0) + own.read(1);
+		});
+		bench("Integrator pass-through lookup", 1, 0, [&]() {
+			sink_float = (float)(std::size_t)accessor.DMAClient<float>::getDMAChannel(1);
+		});
+		bench("Integrator pass-through read", count, 0, [&]() {
+			float sum = 0.f;
+			for (std::size_t i=0; i<count; ++i)
+				sum += passed.read(i);
+			sink_float = sum;
+		});
+		bench("Integrator process", 1, 0, [&]() {
+			integrator.process(frame.next());
+		});
+	}
+
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1)
+		filter = argv[1]; // Only run benchmarks whose names contain this
+	benchRAM40964();
+	benchRAMSizes();
+	benchAccessor();
+	benchClientRemoval();
+	benchDMAFX();
+	benchBits();
+	benchSparse();
+	benchBridge();
+	benchIntegrator();
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,698 @@
+#pragma once
+// Minimal stand-in for the parts of the VCV Rack SDK used by the DMA modules.
+// Only the engine side (Module, Param, Port, Light, dsp, jansson) does real
+// work; widget factories exist so the module sources compile and return null.
+#include <algorithm>
+#include <cmath>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+/* jansson */
+
+enum json_type { JSON_OBJECT, JSON_ARRAY, JSON_STRING, JSON_INTEGER, JSON_REAL, JSON_TRUE, JSON_FALSE, JSON_NULL };
+
+struct json_t {
+	json_type type;
+	std::map<std::string, json_t*> object;
+	std::vector<json_t*> array;
+	std::string string;
+	double real = 0.0;
+	long long integer = 0;
+	explicit json_t(json_type type) : type(type) {}
+};
+
+inline void json_decref(json_t* json) {
+	if (!json)
+		return;
+	for (auto& kv : json->object)
+		json_decref(kv.second);
+	for (json_t* item : json->array)
+		json_decref(item);
+	delete json;
+}
+inline json_t* json_object() { return new json_t(JSON_OBJECT); }
+inline json_t* json_array() { return new json_t(JSON_ARRAY); }
+inline json_t* json_real(double value) { auto j = new json_t(JSON_REAL); j->real = value; return j; }
+inline json_t* json_integer(long long value) { auto j = new json_t(JSON_INTEGER); j->integer = value; return j; }
+inline json_t* json_boolean(bool value) { return new json_t(value ? JSON_TRUE : JSON_FALSE); }
+inline json_t* json_string(const char* value) { auto j = new json_t(JSON_STRING); j->string = value; return j; }
+inline int json_object_set_new(json_t* object, const char* key, json_t* value) {
+	json_decref(object->object[key]);
+	object->object[key] = value;
+	return 0;
+}
+inline json_t* json_object_get(const json_t* object, const char* key) {
+	if (!object || object->type != JSON_OBJECT)
+		return nullptr;
+	auto it = object->object.find(key);
+	return it == object->object.end() ? nullptr : it->second;
+}
+inline int json_array_append_new(json_t* array, json_t* value) { array->array.push_back(value); return 0; }
+inline std::size_t json_array_size(const json_t* array) { return array && array->type == JSON_ARRAY ? array->array.size() : 0; }
+inline json_t* json_array_get(const json_t* array, std::size_t index) { return index < json_array_size(array) ? array->array[index] : nullptr; }
+inline double json_real_value(const json_t* json) { return json && json->type == JSON_REAL ? json->real : 0.0; }
+inline long long json_integer_value(const json_t* json) { return json && json->type == JSON_INTEGER ? json->integer : 0; }
+inline double json_number_value(const json_t* json) { return json && json->type == JSON_INTEGER ? (double)json->integer : json_real_value(json); }
+inline bool json_boolean_value(const json_t* json) { return json && json->type == JSON_TRUE; }
+inline bool json_is_string(const json_t* json) { return json && json->type == JSON_STRING; }
+inline bool json_is_array(const json_t* json) { return json && json->type == JSON_ARRAY; }
+inline const char* json_string_value(const json_t* json) { return json && json->type == JSON_STRING ? json->string.c_str() : nullptr; }
+
+#define JSON_INDENT(n) ((n) & 0x1F)
+inline int json_dump_file(const json_t* json, const char* path, std::size_t flags) { return 0; }
+
+/* nanovg */
+
+struct NVGcolor {
+	float r, g, b, a;
+};
+struct NVGcontext;
+
+namespace rack {
+
+static constexpr int PORT_MAX_CHANNELS = 16;
+static constexpr float RACK_GRID_WIDTH = 15.f;
+static constexpr float RACK_GRID_HEIGHT = 380.f;
+
+namespace math {
+	struct Vec {
+		float x = 0.f, y = 0.f;
+		Vec() = default;
+		Vec(float x, float y) : x(x), y(y) {}
+		Vec plus(Vec b) const { return Vec(x + b.x, y + b.y); }
+		Vec minus(Vec b) const { return Vec(x - b.x, y - b.y); }
+		Vec mult(float s) const { return Vec(x * s, y * s); }
+		Vec operator+(Vec b) const { return plus(b); }
+		Vec operator-(Vec b) const { return minus(b); }
+		Vec operator*(float s) const { return mult(s); }
+	};
+	inline Vec operator*(float s, Vec v) { return v.mult(s); }
+	struct Rect {
+		Vec pos, size;
+	};
+}
+using namespace math;
+
+inline Vec mm2px(Vec mm) {
+	return mm * (75.f / 25.4f);
+}
+
+namespace color {
+	static const NVGcolor RED = {1.f, 0.f, 0.f, 1.f};
+	static const NVGcolor GREEN = {0.f, 1.f, 0.f, 1.f};
+	static const NVGcolor BLUE = {0.f, 0.f, 1.f, 1.f};
+	static const NVGcolor YELLOW = {1.f, 1.f, 0.f, 1.f};
+	static const NVGcolor WHITE = {1.f, 1.f, 1.f, 1.f};
+}
+
+namespace string {
+	inline std::string f(const char* format, ...) {
+		va_list args;
+		va_start(args, format);
+		va_list copy;
+		va_copy(copy, args);
+		int size = std::vsnprintf(nullptr, 0, format, copy);
+		va_end(copy);
+		std::string s(size, '\0');
+		std::vsnprintf(&s[0], size + 1, format, args);
+		va_end(args);
+		return s;
+	}
+
+	inline std::string toBase64(const uint8_t* data, std::size_t len) {
+		static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string s;
+		s.reserve((len + 2) / 3 * 4);
+		for (std::size_t i = 0; i < len; i += 3) {
+			uint32_t n = (uint32_t)data[i] << 16;
+			if (i + 1 < len) n |= (uint32_t)data[i + 1] << 8;
+			if (i + 2 < len) n |= data[i + 2];
+			s += table[(n >> 18) & 63];
+			s += table[(n >> 12) & 63];
+			s += i + 1 < len ? table[(n >> 6) & 63] : '=';
+			s += i + 2 < len ? table[n & 63] : '=';
+		}
+		return s;
+	}
+
+	inline std::vector<uint8_t> fromBase64(const std::string& str) {
+		std::vector<uint8_t> out;
+		uint32_t n = 0;
+		int bits = 0;
+		for (char c : str) {
+			int v;
+			if (c >= 'A' && c <= 'Z') v = c - 'A';
+			else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+			else if (c >= '0' && c <= '9') v = c - '0' + 52;
+			else if (c == '+') v = 62;
+			else if (c == '/') v = 63;
+			else continue;
+			n = (n << 6) | v;
+			bits += 6;
+			if (bits >= 8) {
+				bits -= 8;
+				out.push_back((n >> bits) & 0xff);
+			}
+		}
+		return out;
+	}
+}
+
+namespace random {
+	inline std::mt19937_64& local() {
+		thread_local std::mt19937_64 rng(0x5eed);
+		return rng;
+	}
+	inline void init() {}
+	inline uint64_t u64() { return local()(); }
+	inline uint32_t u32() { return (uint32_t)(u64() >> 32); }
+	inline float uniform() { return (u32() >> 8) * (1.f / 16777216.f); }
+	inline float normal() { return std::normal_distribution<float>()(local()); }
+}
+
+namespace system {
+	double getTime();
+}
+
+namespace settings {
+	extern int threadCount;
+}
+
+namespace dsp {
+	struct SchmittTrigger {
+		bool state = true;
+		void reset() { state = true; }
+		bool process(float in, float lowThreshold = 0.f, float highThreshold = 1.f) {
+			if (state) {
+				if (in <= lowThreshold)
+					state = false;
+			} else if (in >= highThreshold) {
+				state = true;
+				return true;
+			}
+			return false;
+		}
+		bool isHigh() const { return state; }
+	};
+
+	struct PulseGenerator {
+		float remaining = 0.f;
+		void reset() { remaining = 0.f; }
+		bool process(float deltaTime) {
+			if (remaining > 0.f) {
+				remaining -= deltaTime;
+				return true;
+			}
+			return false;
+		}
+		void trigger(float duration = 1e-3f) {
+			if (duration > remaining)
+				remaining = duration;
+		}
+	};
+
+	struct ClockDivider {
+		uint32_t clock = 0, division = 1;
+		void setDivision(uint32_t d) { division = d; }
+		bool process() {
+			if (++clock >= division) {
+				clock = 0;
+				return true;
+			}
+			return false;
+		}
+	};
+}
+
+namespace engine {
+	struct Module;
+
+	struct Param {
+		float value = 0.f;
+		float getValue() const { return value; }
+		void setValue(float v) { value = v; }
+	};
+
+	struct Port {
+		float voltages[PORT_MAX_CHANNELS] = {};
+		uint8_t channels = 0;
+
+		void setVoltage(float voltage, int channel = 0) { voltages[channel] = voltage; }
+		float getVoltage(int channel = 0) const { return voltages[channel]; }
+		float getPolyVoltage(int channel) const { return channels == 1 ? voltages[0] : voltages[channel]; }
+		float getNormalVoltage(float normal, int channel = 0) const { return channels ? voltages[channel] : normal; }
+		void setChannels(int n) {
+			if (channels == 0 && n == 0)
+				return;
+			for (int c = n; c < channels; ++c)
+				voltages[c] = 0.f;
+			channels = std::max(n, 1);
+		}
+		int getChannels() const { return channels; }
+		bool isConnected() const { return channels > 0; }
+		bool isMonophonic() const { return channels == 1; }
+		bool isPolyphonic() const { return channels > 1; }
+		void readVoltages(float* v) const {
+			for (int c = 0; c < channels; ++c)
+				v[c] = voltages[c];
+		}
+		void writeVoltages(const float* v) {
+			for (int c = 0; c < channels; ++c)
+				voltages[c] = v[c];
+		}
+		void clearVoltages() {
+			for (float& v : voltages)
+				v = 0.f;
+		}
+	};
+	struct Input : Port {};
+	struct Output : Port {};
+
+	struct Light {
+		float value = 0.f;
+		void setBrightness(float brightness) { value = brightness; }
+		float getBrightness() const { return value; }
+		void setBrightnessSmooth(float brightness, float deltaTime, float lambda = 30.f) {
+			if (brightness < value)
+				value = brightness;
+			else
+				value += (brightness - value) * std::min(1.f, lambda * deltaTime);
+		}
+	};
+
+	struct ParamQuantity {
+		Module* module = nullptr;
+		int paramId = -1;
+		float minValue = 0.f, maxValue = 1.f, defaultValue = 0.f;
+		std::string name, unit;
+		bool snapEnabled = false;
+		bool smoothEnabled = false;
+		bool randomizeEnabled = true;
+		std::string description;
+		virtual ~ParamQuantity() = default;
+	};
+	struct SwitchQuantity : ParamQuantity {
+		std::vector<std::string> labels;
+	};
+	struct PortInfo {
+		std::string name, description;
+	};
+	struct LightInfo {
+		std::string name, description;
+	};
+
+	struct Module {
+		int64_t id = -1;
+		std::vector<Param> params;
+		std::vector<Input> inputs;
+		std::vector<Output> outputs;
+		std::vector<Light> lights;
+		std::vector<ParamQuantity*> paramQuantities;
+		std::vector<PortInfo*> inputInfos;
+		std::vector<PortInfo*> outputInfos;
+
+		struct Expander {
+			int64_t moduleId = -1;
+			Module* module = nullptr;
+			void* producerMessage = nullptr;
+			void* consumerMessage = nullptr;
+			bool messageFlipRequested = false;
+			void requestMessageFlip() { messageFlipRequested = true; }
+		};
+		Expander leftExpander, rightExpander;
+
+		Module() = default;
+		Module(const Module&) = delete;
+		Module& operator=(const Module&) = delete;
+		virtual ~Module() {
+			for (auto pq : paramQuantities)
+				delete pq;
+			for (auto info : inputInfos)
+				delete info;
+			for (auto info : outputInfos)
+				delete info;
+		}
+
+		void config(int numParams, int numInputs, int numOutputs, int numLights = 0) {
+			params.resize(numParams);
+			inputs.resize(numInputs);
+			outputs.resize(numOutputs);
+			lights.resize(numLights);
+			paramQuantities.resize(numParams, nullptr);
+			inputInfos.resize(numInputs, nullptr);
+			outputInfos.resize(numOutputs, nullptr);
+		}
+
+		template <class TParamQuantity = ParamQuantity>
+		TParamQuantity* configParam(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::string unit = "", float displayBase = 0.f, float displayMultiplier = 1.f, float displayOffset = 0.f) {
+			delete paramQuantities[paramId];
+			auto q = new TParamQuantity;
+			q->module = this;
+			q->paramId = paramId;
+			q->minValue = minValue;
+			q->maxValue = maxValue;
+			q->defaultValue = defaultValue;
+			q->name = name;
+			q->unit = unit;
+			paramQuantities[paramId] = q;
+			params[paramId].value = defaultValue;
+			return q;
+		}
+
+		template <class TSwitchQuantity = SwitchQuantity>
+		TSwitchQuantity* configSwitch(int paramId, float minValue, float maxValue, float defaultValue, std::string name = "", std::vector<std::string> labels = {}) {
+			auto q = configParam<TSwitchQuantity>(paramId, minValue, maxValue, defaultValue, name);
+			q->snapEnabled = true;
+			q->labels = labels;
+			return q;
+		}
+
+		template <class TSwitchQuantity = SwitchQuantity>
+		TSwitchQuantity* configButton(int paramId, std::string name = "") {
+			return configSwitch<TSwitchQuantity>(paramId, 0.f, 1.f, 0.f, name, {"", ""});
+		}
+
+		PortInfo* configInput(int portId, std::string name = "") {
+			delete inputInfos[portId];
+			return inputInfos[portId] = new PortInfo{name, ""};
+		}
+
+		PortInfo* configOutput(int portId, std::string name = "") {
+			delete outputInfos[portId];
+			return outputInfos[portId] = new PortInfo{name, ""};
+		}
+
+		LightInfo* configLight(int lightId, std::string name = "") {
+			return nullptr;
+		}
+
+		void configBypass(int inputId, int outputId) {}
+
+		struct ProcessArgs {
+			float sampleRate = 48000.f;
+			float sampleTime = 1.f / 48000.f;
+			int64_t frame = 0;
+		};
+		virtual void process(const ProcessArgs& args) {}
+		virtual void processBypass(const ProcessArgs& args) {}
+
+		struct ExpanderChangeEvent {
+			uint8_t side = 0;
+		};
+		virtual void onExpanderChange(const ExpanderChangeEvent& e) {}
+
+		struct ResetEvent {};
+		virtual void onReset(const ResetEvent& e) {}
+
+		struct RandomizeEvent {};
+		virtual void onRandomize(const RandomizeEvent& e) {}
+
+		struct AddEvent {};
+		virtual void onAdd(const AddEvent& e) {}
+
+		struct RemoveEvent {};
+		virtual void onRemove(const RemoveEvent& e) {}
+
+		struct SampleRateChangeEvent {
+			float sampleRate;
+			float sampleTime;
+		};
+		virtual void onSampleRateChange(const SampleRateChangeEvent& e) {}
+
+		virtual json_t* dataToJson() { return nullptr; }
+		virtual void dataFromJson(json_t* root) {}
+	};
+
+	struct Engine {
+		int getNumThreads() { return 1; }
+		float getSampleRate() { return 48000.f; }
+		Module* getModule(int64_t moduleId) { return nullptr; }
+	};
+}
+using namespace engine;
+
+namespace plugin {
+	struct Model {
+		std::string slug;
+	};
+	struct Plugin {
+		std::vector<Model*> models;
+		void addModel(Model* model) { models.push_back(model); }
+	};
+}
+using namespace plugin;
+
+namespace asset {
+	inline std::string plugin(Plugin* plugin, std::string filename) { return filename; }
+	inline std::string system(std::string filename) { return filename; }
+	inline std::string user(std::string filename) { return filename; }
+}
+
+namespace history {
+	struct Action {
+		std::string name;
+		virtual ~Action() = default;
+		virtual void undo() {}
+		virtual void redo() {}
+	};
+	struct ModuleAction : Action {
+		int64_t moduleId = -1;
+	};
+	struct State {
+		void push(Action* action) { delete action; }
+	};
+}
+
+struct Svg {
+	static std::shared_ptr<Svg> load(const std::string& filename) { return nullptr; }
+};
+
+namespace widget {
+	struct Widget {
+		Rect box;
+		Widget* parent = nullptr;
+		bool visible = true;
+		std::vector<Widget*> children;
+		virtual ~Widget() {
+			for (Widget* child : children)
+				delete child;
+		}
+		struct DrawArgs {
+			NVGcontext* vg = nullptr;
+			Rect clipBox;
+		};
+		virtual void step() {
+			for (Widget* child : children)
+				child->step();
+		}
+		virtual void draw(const DrawArgs& args) {}
+		virtual void drawLayer(const DrawArgs& args, int layer) {}
+		void addChild(Widget* child) {
+			if (child)
+				children.push_back(child);
+		}
+		void show() { visible = true; }
+		void hide() { visible = false; }
+	};
+	struct TransparentWidget : Widget {};
+	struct OpaqueWidget : Widget {};
+	struct SvgWidget : Widget {
+		void setSvg(std::shared_ptr<Svg> svg) {}
+	};
+	struct FramebufferWidget : Widget {
+		void setDirty(bool dirty = true) {}
+	};
+}
+using namespace widget;
+
+struct Font {
+	int handle = 0;
+};
+
+namespace ui {
+	struct Label : Widget {
+		enum Alignment {
+			LEFT_ALIGNMENT,
+			CENTER_ALIGNMENT,
+			RIGHT_ALIGNMENT,
+		};
+		std::string text;
+		float fontSize = 13.f;
+		float lineHeight = 13.f;
+		NVGcolor color;
+		Alignment alignment = LEFT_ALIGNMENT;
+	};
+	struct MenuEntry : OpaqueWidget {};
+	struct MenuLabel : MenuEntry {
+		std::string text;
+	};
+	struct MenuSeparator : MenuEntry {};
+	struct MenuItem : MenuEntry {
+		std::string text, rightText;
+		bool disabled = false;
+		struct ActionEvent {};
+		virtual void onAction(const ActionEvent& e) {}
+		virtual Widget* createChildMenu() { return nullptr; }
+	};
+	struct Menu : OpaqueWidget {};
+}
+using namespace ui;
+
+namespace app {
+	struct ParamWidget : OpaqueWidget {};
+	struct PortWidget : OpaqueWidget {};
+	struct LightWidget : TransparentWidget {};
+	struct ModuleLightWidget : LightWidget {
+		std::vector<NVGcolor> baseColors;
+		void addBaseColor(NVGcolor c) { baseColors.push_back(c); }
+		int getNumColors() { return (int)baseColors.size(); }
+	};
+	struct MultiLightWidget : ModuleLightWidget {};
+	struct SvgPanel : Widget {};
+	struct SvgPort : PortWidget {};
+	struct SvgKnob : ParamWidget {
+		void setSvg(std::shared_ptr<Svg> svg) {}
+	};
+	struct SvgSlider : ParamWidget {};
+	struct SvgSwitch : ParamWidget {
+		struct Shadow {
+			float opacity = 1.f;
+		};
+		Shadow* shadow = nullptr;
+		bool momentary = false;
+		void addFrame(std::shared_ptr<Svg> svg) {}
+	};
+	struct SvgScrew : Widget {};
+
+	struct ModuleWidget : OpaqueWidget {
+		Module* module = nullptr;
+		Model* model = nullptr;
+		Module* getModule() { return module; }
+		void setModule(Module* m) { module = m; }
+		void setPanel(Widget* panel) {
+			if (panel)
+				addChild(panel);
+			box.size = Vec(RACK_GRID_WIDTH * 10, RACK_GRID_HEIGHT);
+		}
+		template <class T> void addParam(T* param) {}
+		template <class T> void addInput(T* input) {}
+		template <class T> void addOutput(T* output) {}
+		virtual void appendContextMenu(Menu* menu) {}
+	};
+
+	struct Scene {
+		Widget* rack = nullptr;
+	};
+	struct Window {
+		std::shared_ptr<Font> loadFont(const std::string& filename) { return nullptr; }
+		std::shared_ptr<Font> uiFont;
+	};
+	struct Application {
+		Engine* engine = nullptr;
+		history::State* history = nullptr;
+		Window* window = nullptr;
+		Scene* scene = nullptr;
+	};
+	Application* appGet();
+}
+using namespace app;
+#define APP rack::app::appGet()
+
+namespace componentlibrary {
+	static const NVGcolor SCHEME_RED = {0.93f, 0.10f, 0.20f, 1.f};
+	static const NVGcolor SCHEME_GREEN = {0.56f, 0.75f, 0.20f, 1.f};
+	static const NVGcolor SCHEME_BLUE = {0.16f, 0.52f, 0.96f, 1.f};
+	static const NVGcolor SCHEME_YELLOW = {1.f, 0.84f, 0.f, 1.f};
+	static const NVGcolor SCHEME_PURPLE = {0.82f, 0.28f, 0.95f, 1.f};
+	static const NVGcolor SCHEME_ORANGE = {1.f, 0.50f, 0.f, 1.f};
+
+	struct GrayModuleLightWidget : MultiLightWidget {};
+	template <typename TBase = GrayModuleLightWidget> struct TRedLight : TBase {};
+	template <typename TBase = GrayModuleLightWidget> struct TGreenLight : TBase {};
+	template <typename TBase = GrayModuleLightWidget> struct TBlueLight : TBase {};
+	template <typename TBase = GrayModuleLightWidget> struct TYellowLight : TBase {};
+	template <typename TBase = GrayModuleLightWidget> struct TWhiteLight : TBase {};
+	template <typename TBase = GrayModuleLightWidget> struct TGreenRedLight : TBase {};
+	template <typename TBase = GrayModuleLightWidget> struct TRedGreenBlueLight : TBase {};
+	using RedLight = TRedLight<>;
+	using GreenLight = TGreenLight<>;
+	using BlueLight = TBlueLight<>;
+	using YellowLight = TYellowLight<>;
+	using WhiteLight = TWhiteLight<>;
+	using GreenRedLight = TGreenRedLight<>;
+	using RedGreenBlueLight = TRedGreenBlueLight<>;
+	template <typename TBase> struct TinySimpleLight : TBase {};
+	template <typename TBase> struct TinyLight : TBase {};
+	template <typename TBase> struct SmallLight : TBase {};
+	template <typename TBase> struct SmallSimpleLight : TBase {};
+	template <typename TBase> struct MediumLight : TBase {};
+	template <typename TBase> struct LargeLight : TBase {};
+	template <typename TBase> struct VCVLightLatch : SvgSwitch {};
+	template <typename TBase> struct VCVLightBezel : SvgSwitch {};
+
+	struct ScrewSilver : SvgScrew {};
+	struct ScrewBlack : SvgScrew {};
+	struct Rogan : SvgKnob {
+		SvgWidget* bg = nullptr;
+		SvgWidget* fg = nullptr;
+	};
+	struct RoundKnob : SvgKnob {};
+	struct RoundBlackKnob : RoundKnob {};
+	struct RoundSmallBlackKnob : RoundKnob {};
+	struct RoundLargeBlackKnob : RoundKnob {};
+	struct Trimpot : SvgKnob {};
+	struct CKSS : SvgSwitch {};
+	struct CKSSThree : SvgSwitch {};
+	struct CKD6 : SvgSwitch {};
+	struct CKSSThreeHorizontal : SvgSwitch {};
+	struct VCVButton : SvgSwitch {};
+	struct TL1105 : SvgSwitch {};
+	struct PJ301MPort : SvgPort {};
+	struct PJ3410Port : SvgPort {};
+	struct CL1362Port : SvgPort {};
+}
+using namespace componentlibrary;
+
+/* Widget factories. Nothing is drawn headless, so these never construct widgets. */
+
+inline SvgPanel* createPanel(std::string svgPath) { return nullptr; }
+template <class TWidget> TWidget* createWidget(Vec pos) { return nullptr; }
+template <class TWidget> TWidget* createWidgetCentered(Vec pos) { return nullptr; }
+template <class TParamWidget> TParamWidget* createParam(Vec pos, Module* module, int paramId) { return nullptr; }
+template <class TParamWidget> TParamWidget* createParamCentered(Vec pos, Module* module, int paramId) { return nullptr; }
+template <class TParamWidget> TParamWidget* createLightParamCentered(Vec pos, Module* module, int paramId, int firstLightId) { return nullptr; }
+template <class TPortWidget> TPortWidget* createInputCentered(Vec pos, Module* module, int inputId) { return nullptr; }
+template <class TPortWidget> TPortWidget* createOutputCentered(Vec pos, Module* module, int outputId) { return nullptr; }
+template <class TLightWidget> TLightWidget* createLight(Vec pos, Module* module, int firstLightId) { return nullptr; }
+template <class TLightWidget> TLightWidget* createLightCentered(Vec pos, Module* module, int firstLightId) { return nullptr; }
+
+inline MenuLabel* createMenuLabel(std::string text) { return nullptr; }
+template <class TMenuItem = MenuItem> TMenuItem* createMenuItem(std::string text, std::string rightText = "", std::function<void()> action = {}, bool disabled = false) { return nullptr; }
+inline MenuItem* createCheckMenuItem(std::string text, std::string rightText, std::function<bool()> checked, std::function<void()> action, bool disabled = false) { return nullptr; }
+template <typename T> MenuItem* createBoolPtrMenuItem(std::string text, std::string rightText, T* ptr) { return nullptr; }
+inline MenuItem* createBoolMenuItem(std::string text, std::string rightText, std::function<bool()> getter, std::function<void(bool)> setter) { return nullptr; }
+inline MenuItem* createSubmenuItem(std::string text, std::string rightText, std::function<void(Menu*)> createMenu, bool disabled = false) { return nullptr; }
+inline MenuItem* createIndexSubmenuItem(std::string text, std::vector<std::string> labels, std::function<size_t()> getter, std::function<void(size_t)> setter, bool disabled = false) { return nullptr; }
+template <typename T> MenuItem* createIndexPtrSubmenuItem(std::string text, std::vector<std::string> labels, T* ptr) { return nullptr; }
+
+template <class TModule, class TModuleWidget>
+Model* createModel(std::string slug) {
+	auto model = new Model;
+	model->slug = slug;
+	return model;
+}
+
+}
+
+/* blendish */
+enum BNDtextAlignment { BND_LEFT, BND_CENTER };
+inline void bndSetFont(int font) {}
+inline void bndIconLabelValue(NVGcontext* ctx, float x, float y, float w, float h, int iconid, NVGcolor color, int align, float fontsize, const char* label, const char* value) {}
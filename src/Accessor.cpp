@@ -54,6 +54,11 @@ struct Accessor : DMAExpanderModule<float, bool> {
 	};
 
 	dsp::SchmittTrigger write_triggers[PORT_MAX_CHANNELS];
+	float readbackF[2][PORT_MAX_CHANNELS] = {};
+	bool readbackB[2][PORT_MAX_CHANNELS] = {};
+
+	float *getReadback(const float *, int page) { return readbackF[page]; }
+	bool *getReadback(const bool *, int page) { return readbackB[page]; }
 
 	Accessor() {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -71,7 +76,7 @@ struct Accessor : DMAExpanderModule<float, bool> {
 	}
 
 	template <typename T>
-	void processType(const ProcessArgs &args, DMAChannel<T> &dma, int addr_count, const int *addresses, int write_nchan, const float *write_voltages, int data_nchan, const float *data_voltages) {
+	void processType(const ProcessArgs &args, DMAChannel<T> &dma, const DMAChannelInfo &info, int addr_count, const int *addresses, int write_nchan, const float *write_voltages, int data_nchan, const float *data_voltages) {
 		int write_mode = (int)params[WRITE_PARAM].getValue();
 		bool write_all = (write_mode == 1);
 		bool write_channels[PORT_MAX_CHANNELS];
@@ -89,7 +94,10 @@ struct Accessor : DMAExpanderModule<float, bool> {
 			}
 		}
 
-		if (write_all || (write_nchan == 1 && write_channels[0])) {
+		// Writes to a read-only channel would be dropped by the channel anyway
+		if (!info.writable)
+			write_nchan = 0;
+		else if (write_all || (write_nchan == 1 && write_channels[0])) {
 			write_nchan = addr_count;
 			write_all = true;
 		}
@@ -97,22 +105,49 @@ struct Accessor : DMAExpanderModule<float, bool> {
 		float data_scale = params[DATA_PARAM].getValue();
 		T data_in = convertDataInput<T>(data_scale);
 		data_scale /= 10;
+		DMACommand<T> command;
+		command.type = DMACommand<T>::WRITE;
+		command.channel = &dma;
 		for (int i=0; i<write_nchan; ++i) {
 			if (write_all || write_channels[i]) {
 				if (i < data_nchan)
 					data_in = convertDataInput<T>(data_voltages[i] * data_scale);
-				dma[addresses[i]] = data_in;
+				command.addresses[command.count] = addresses[i];
+				command.values[command.count++] = data_in;
 			}
 		}
-
-		float light = convertForDataLight<T>(dma[addresses[0]]);
+		if (command.count)
+			submitDMACommand(command); // Dropped if the host's queue is full
+
+		T data_out[PORT_MAX_CHANNELS];
+		int read_count = std::max(addr_count, 1);
+		if (info.has(DMAChannelInfo::QUEUED) && settings::threadCount > 1) {
+			// The host may be in its own process() on another thread, so reads are queued
+			// too and land in one of two pages, picked by frame parity; the page requested
+			// two frames ago is complete and untouched by the host now, so the output lags
+			// the memory by two frames. If the queue is full, the page keeps what it last held.
+			T *readback = getReadback((const T *)nullptr, (int)(dma_frame & 1));
+			std::copy(readback, readback + PORT_MAX_CHANNELS, data_out);
+			DMACommand<T> read;
+			read.type = DMACommand<T>::READ;
+			read.channel = &dma;
+			read.count = read_count;
+			std::copy(addresses, addresses + read.count, read.addresses);
+			read.target = readback;
+			submitDMACommand(read);
+		} else {
+			// Hosts without a queue, or any host when the engine runs on one thread, are
+			// read directly, with no delay
+			dma.readGather(addresses, read_count, data_out);
+		}
+		float light = convertForDataLight<T>(data_out[0]);
 		lights[DATA_LIGHT_G].setBrightnessSmooth(light, args.sampleTime);
 		lights[DATA_LIGHT_R].setBrightnessSmooth(-light, args.sampleTime);
 
 		outputs[DATA_OUTPUT].setChannels(addr_count);
 		float data_out_voltages[PORT_MAX_CHANNELS];
 		for (int i=0; i<addr_count; ++i)
-			data_out_voltages[i] = (float)dma[addresses[i]];
+			data_out_voltages[i] = (float)data_out[i];
 		outputs[DATA_OUTPUT].writeVoltages(data_out_voltages);
 	}
 
@@ -150,18 +185,12 @@ turn_off_data_lights_and_return:
 		DMAChannel<float> *pdmaF = DMAClient<float>::getDMAChannel(channel);
 		DMAChannel<bool> *pdmaB = DMAClient<bool>::getDMAChannel(channel);
 
-		int width = 1;
-		int height = 1;
-		if (pdmaF) {
-			width = pdmaF->width();
-			height = pdmaF->height();
-		} else if (pdmaB) {
-			width = pdmaB->width();
-			height = pdmaB->height();
-		} else {
+		if (!pdmaF && !pdmaB)
 			return;
-		}
-		
+		const DMAChannelInfo &info = pdmaF ? DMAClient<float>::getDMAChannelInfo(channel) : DMAClient<bool>::getDMAChannelInfo(channel);
+		int width = (int)info.width;
+		int height = (int)info.height;
+
 		int addresses[PORT_MAX_CHANNELS];
 		fillAddressArray(0, 0, x_nchan, y_nchan, x_voltages, y_voltages, addresses, 1, width, height);
 
@@ -177,9 +206,9 @@ turn_off_data_lights_and_return:
 
 		int addr_count = std::max(x_nchan, y_nchan);
 		if (pdmaF)
-			processType(args, *pdmaF, addr_count, addresses, write_nchan, write_voltages, data_nchan, data_voltages);
+			processType(args, *pdmaF, info, addr_count, addresses, write_nchan, write_voltages, data_nchan, data_voltages);
 		else if (pdmaB)
-			processType(args, *pdmaB, addr_count, addresses, write_nchan, write_voltages, data_nchan, data_voltages);
+			processType(args, *pdmaB, info, addr_count, addresses, write_nchan, write_voltages, data_nchan, data_voltages);
 	}
 };
 
@@ -210,6 +239,11 @@ struct AccessorWidget : ModuleWidget {
 		addChild(createLightCentered<SmallLight<BlueLight>>(Vec(8.0, 8.0), module, Accessor::DMA_CLIENT_LIGHT));
 		addChild(createLightCentered<SmallLight<GreenRedLight>>(Vec(box.size.x - 8.0, 8.0), module, Accessor::DMA_HOST_LIGHT_G));
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		if (module)
+			appendDMAProfileMenu(menu, module);
+	}
 };
 
 
@@ -1,139 +1,2136 @@
+#pragma once
 #include "plugin.hpp"
 #include "Utility.hpp"
 #include <set>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 namespace sparkette {
 
+	inline int64_t getDMAProfileClock() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+#ifdef SPARKETTE_DMA_PROFILE
+	// Access counters for finding slow links in a DMA chain; only built with DMA_PROFILE=1.
+	struct DMAProfile {
+		std::atomic<uint64_t> reads;
+		std::atomic<uint64_t> writes;
+		std::atomic<uint64_t> events;
+		std::atomic<uint64_t> bytes; // Moved by block operations and transforms
+		std::atomic<uint64_t> nanoseconds;
+		std::atomic<int64_t> since; // Clock when the counters were last reset
+
+		DMAProfile() : reads(0), writes(0), events(0), bytes(0), nanoseconds(0), since(getDMAProfileClock()) {}
+
+		void reset() {
+			reads.store(0, std::memory_order_relaxed);
+			writes.store(0, std::memory_order_relaxed);
+			events.store(0, std::memory_order_relaxed);
+			bytes.store(0, std::memory_order_relaxed);
+			nanoseconds.store(0, std::memory_order_relaxed);
+			since.store(getDMAProfileClock(), std::memory_order_relaxed);
+		}
+
+		void add(std::atomic<uint64_t> &counter, uint64_t n) {
+			counter.fetch_add(n, std::memory_order_relaxed);
+		}
+
+		double getSeconds() const {
+			return std::max(1e-9 * (double)(getDMAProfileClock() - since.load(std::memory_order_relaxed)), 1e-3);
+		}
+	};
+
+	inline std::atomic<bool> &dmaProfiling() {
+		static std::atomic<bool> enabled(false);
+		return enabled;
+	}
+
+	inline bool isDMAProfiling() {
+		return dmaProfiling().load(std::memory_order_relaxed);
+	}
+#else
+	inline bool isDMAProfiling() {
+		return false;
+	}
+#endif
+
 	template <typename T>
 	class DMAChannel;
 
+	// Raised once per write, or per outermost transaction; x/y/width/height bound the cells written.
+	template <typename T>
+	struct DMAWriteEvent {
+		DMAChannel<T> *channel;
+		std::size_t index;
+		std::size_t x = 0;
+		std::size_t y = 0;
+		std::size_t width = 1;
+		std::size_t height = 1;
+	};
+
+	template <typename T>
+	struct DMATransactionEvent {
+		DMAChannel<T> *channel;
+	};
+
+	template <typename T>
+	class DMAHost;
+
+	template <typename T>
+	class DMACommandQueue;
+
+	template <typename T>
+	struct DMACommand;
+
+	template <typename T>
+	struct DMAScratch;
+
+	// Direct view of a channel's backing memory. Element i lives at ptr[i * stride].
+	template <typename T>
+	struct DMASpan {
+		T *ptr = nullptr;
+		std::size_t count = 0;
+		std::size_t stride = 1;
+
+		DMASpan() = default;
+		DMASpan(T *ptr, std::size_t count, std::size_t stride = 1) : ptr(ptr), count(count), stride(stride) {}
+
+		explicit operator bool() const {
+			return ptr != nullptr;
+		}
+
+		std::size_t size() const {
+			return count;
+		}
+
+		T &operator[](std::size_t index) const {
+			return ptr[index * stride];
+		}
+
+		DMASpan slice(std::size_t start, std::size_t n) const {
+			return DMASpan(ptr + start * stride, n, stride);
+		}
+	};
+
+	// Grow-only scratch storage for bulk transfers (std::vector<bool> has no data()).
+	template <typename T>
+	class DMABuffer {
+		std::unique_ptr<T[]> buffer;
+		std::size_t capacity = 0;
+
+	public:
+		T *get(std::size_t n) {
+			if (n > capacity) {
+				buffer.reset(new T[n]);
+				capacity = n;
+			}
+			return buffer.get();
+		}
+
+		const T *data() const {
+			return buffer.get();
+		}
+	};
+
+	// What a client needs to pick a code path for a channel, gathered in one call.
+	struct DMAChannelInfo {
+		enum ElementType { FLOAT, BOOL };
+		enum Feature {
+			DIRECT = 1 << 0, // getSpan() reaches the memory itself
+			CONTIGUOUS = 1 << 1, // ... with stride 1, so it is one plain array
+			PACKED_BITS = 1 << 2, // A DMABitChannel, open to word-at-a-time operations
+			SPARSE = 1 << 3, // Paged, with unpopulated pages reading as zero
+			QUEUED = 1 << 4, // The owner applies submitted commands in a batch
+		};
+		ElementType type = FLOAT;
+		std::size_t width = 0;
+		std::size_t height = 0;
+		std::size_t stride = 1; // Of the span, when DIRECT
+		bool writable = false;
+		float min_value = 0.f; // Range of the values the channel can hold
+		float max_value = 0.f;
+		unsigned features = 0;
+
+		bool has(Feature feature) const {
+			return (features & feature) != 0;
+		}
+
+		bool isSquare() const {
+			return width == height;
+		}
+	};
+
+	template <typename T>
+	struct DMAElementTraits;
+
+	template <>
+	struct DMAElementTraits<float> {
+		static DMAChannelInfo::ElementType type() { return DMAChannelInfo::FLOAT; }
+		static float minValue() { return -10.f; }
+		static float maxValue() { return 10.f; }
+	};
+
+	template <>
+	struct DMAElementTraits<bool> {
+		static DMAChannelInfo::ElementType type() { return DMAChannelInfo::BOOL; }
+		static float minValue() { return 0.f; }
+		static float maxValue() { return 1.f; }
+	};
+
+	template <typename T>
+	class DMAChannel {
+	protected:
+		T *mem_start = nullptr;
+		DMAHost<T> *owner = nullptr;
+		std::size_t count = 0;
+		std::size_t stride = 1;
+		std::size_t columns = 1;
+
+	private:
+		int transaction_depth = 0;
+		bool transaction_dirty = false;
+		std::size_t dirty_x0, dirty_y0, dirty_x1, dirty_y1;
+		uint64_t version = 0;
+		std::vector<uint64_t> row_versions;
+		std::atomic<unsigned> info_version{0};
+#ifdef SPARKETTE_DMA_PROFILE
+		DMAProfile profile;
+#endif
+
+		void bumpDMAVersion(std::size_t y0, std::size_t y1) {
+			++version;
+			std::size_t rows = height();
+			if (row_versions.size() < rows)
+				row_versions.resize(rows, version); // Layout changed without setup()
+			for (std::size_t y=y0; y<=y1 && y<rows; ++y)
+				row_versions[y] = version;
+		}
+
+	protected:
+		void markDMAInfoChanged() {
+			info_version.fetch_add(1, std::memory_order_release);
+		}
+
+	private:
+		void fireDMAWrite(std::size_t x0, std::size_t y0, std::size_t x1, std::size_t y1) {
+			if (!owner)
+				return;
+			DMAWriteEvent<T> e;
+			e.channel = this;
+			e.index = width() * y0 + x0;
+			e.x = x0;
+			e.y = y0;
+			e.width = x1 - x0 + 1;
+			e.height = y1 - y0 + 1;
+#ifdef SPARKETTE_DMA_PROFILE
+			if (isDMAProfiling()) {
+				profile.add(profile.events, 1);
+				owner->dma_host_profile.add(owner->dma_host_profile.events, 1);
+			}
+#endif
+			owner->onDMAWrite(e);
+		}
+
+		void signalDMARect(std::size_t x0, std::size_t y0, std::size_t x1, std::size_t y1) {
+			bumpDMAVersion(y0, y1);
+			if (transaction_depth > 0) {
+				if (transaction_dirty) {
+					dirty_x0 = std::min(dirty_x0, x0);
+					dirty_y0 = std::min(dirty_y0, y0);
+					dirty_x1 = std::max(dirty_x1, x1);
+					dirty_y1 = std::max(dirty_y1, y1);
+				} else {
+					dirty_x0 = x0; dirty_y0 = y0;
+					dirty_x1 = x1; dirty_y1 = y1;
+					transaction_dirty = true;
+				}
+			} else {
+				fireDMAWrite(x0, y0, x1, y1);
+			}
+		}
+
+	protected:
+		void signalDMAWrite(std::size_t index) {
+			std::size_t cols = width();
+			std::size_t x = index % cols;
+			std::size_t y = index / cols;
+			signalDMARect(x, y, x, y);
+		}
+
+		// Signals n cells starting at index start, step indices apart, as a single bounding rectangle.
+		void signalDMAWrite(std::size_t start, std::size_t n, std::size_t step) {
+			if (n == 0)
+				return;
+			std::size_t cols = width();
+			std::size_t last = start + (n - 1) * step;
+			std::size_t y0 = start / cols;
+			std::size_t y1 = last / cols;
+			if (y0 == y1 || step % cols == 0) {
+				std::size_t x0 = start % cols;
+				std::size_t x1 = last % cols;
+				signalDMARect(std::min(x0, x1), y0, std::max(x0, x1), y1);
+			} else {
+				signalDMARect(0, y0, cols - 1, y1);
+			}
+		}
+
+		// Signals an arbitrary set of n cells as a single bounding rectangle.
+		void signalDMAWrite(const int *addrs, int n) {
+			if (n <= 0)
+				return;
+			std::size_t cols = width();
+			std::size_t x0 = addrs[0] % cols, x1 = x0;
+			std::size_t y0 = addrs[0] / cols, y1 = y0;
+			for (int i=1; i<n; ++i) {
+				std::size_t x = addrs[i] % cols;
+				std::size_t y = addrs[i] / cols;
+				x0 = std::min(x0, x); x1 = std::max(x1, x);
+				y0 = std::min(y0, y); y1 = std::max(y1, y);
+			}
+			signalDMARect(x0, y0, x1, y1);
+		}
+
+	public:
+		class accessor {
+			friend class DMAChannel<T>;
+			DMAChannel *channel;
+			std::size_t index;
+		public:
+			operator T() const { return channel->read(index); }
+			accessor& operator=(T rhs) {
+				channel->write(index, rhs);
+				return *this;
+			}
+		};
+
+		void setup(DMAHost<T> *owner, std::size_t count, T *mem_start = nullptr, std::size_t stride = 1) {
+			this->owner = owner;
+			this->count = count;
+			this->mem_start = mem_start;
+			this->stride = stride;
+			columns = 1;
+			row_versions.clear();
+		}
+
+		void setup(DMAHost<T> *owner, std::size_t width, std::size_t height, T *mem_start = nullptr, std::size_t stride = 1) {
+			setup(owner, width * height, mem_start, stride);
+			columns = width;
+			row_versions.assign(height, version);
+		}
+
+		DMAChannel() = default;
+		DMAChannel(DMAHost<T> *owner, T *mem_start, std::size_t count, std::size_t columns = 1, std::size_t stride = 1)
+			: owner(owner), mem_start(mem_start), count(count), stride(stride), columns(columns) {}
+		DMAChannel(const DMAChannel& other) = delete;
+		DMAChannel& operator=(const DMAChannel& other) = delete;
+
+		virtual T read(std::size_t index) const {
+			return mem_start[index * stride];
+		}
+
+		T read(std::size_t col, std::size_t row) const {
+			return read(columns * row + col);
+		}
+
+		virtual void write(std::size_t index, T value) {
+			if (!isWritable())
+				return;
+			mem_start[index * stride] = value;
+			signalDMAWrite(index);
+		}
+
+		void write(std::size_t col, std::size_t row, T value) {
+			write(columns * row + col, value);
+		}
+
+		virtual bool isWritable() const {
+			return true;
+		}
+
+		// Changes whenever getDMAInfo() would return something new without a rewiring.
+		virtual unsigned getDMAInfoVersion() const {
+			return info_version.load(std::memory_order_acquire);
+		}
+
+		// Channels backed by plain memory expose it directly; computed channels return an empty span.
+		DMASpan<const T> getSpan() const {
+			return DMASpan<const T>(mem_start, mem_start ? count : 0, stride);
+		}
+
+		DMASpan<T> getWritableSpan() {
+			if (!isWritable())
+				return DMASpan<T>();
+			return DMASpan<T>(mem_start, mem_start ? count : 0, stride);
+		}
+
+		// Copies n elements starting at index start, step indices apart, into out.
+		virtual void readBlock(std::size_t start, std::size_t n, T *out, std::size_t step = 1) const {
+			if (mem_start) {
+				const T *src = mem_start + start * stride;
+				std::size_t src_step = step * stride;
+				for (std::size_t i=0; i<n; ++i)
+					out[i] = src[i * src_step];
+			} else {
+				for (std::size_t i=0; i<n; ++i)
+					out[i] = read(start + i * step);
+			}
+		}
+
+		// Counterpart to readBlock. Raises a single write event for the whole block.
+		virtual void writeBlock(std::size_t start, std::size_t n, const T *in, std::size_t step = 1) {
+			if (n == 0 || !isWritable())
+				return;
+			if (mem_start) {
+				T *dest = mem_start + start * stride;
+				std::size_t dest_step = step * stride;
+				for (std::size_t i=0; i<n; ++i)
+					dest[i * dest_step] = in[i];
+				signalDMAWrite(start, n, step);
+			} else {
+				beginWrite();
+				for (std::size_t i=0; i<n; ++i)
+					write(start + i * step, in[i]);
+				commitWrite();
+			}
+		}
+
+		// Writes up to the matching commitWrite are reported as one event. Prefer DMATransaction.
+		virtual void beginWrite() {
+			if (transaction_depth++ == 0 && owner) {
+				DMATransactionEvent<T> e;
+				e.channel = this;
+				owner->onDMABegin(e);
+			}
+		}
+
+		virtual void commitWrite() {
+			if (transaction_depth == 0 || --transaction_depth > 0)
+				return;
+			if (transaction_dirty) {
+				transaction_dirty = false;
+				fireDMAWrite(dirty_x0, dirty_y0, dirty_x1, dirty_y1);
+			}
+			if (owner) {
+				DMATransactionEvent<T> e;
+				e.channel = this;
+				owner->onDMACommit(e);
+			}
+		}
+
+		// Reads the n cells listed in addrs, e.g. one per polyphonic voice.
+		virtual void readGather(const int *addrs, int n, T *out) const {
+			if (mem_start) {
+				for (int i=0; i<n; ++i)
+					out[i] = mem_start[addrs[i] * stride];
+			} else {
+				for (int i=0; i<n; ++i)
+					out[i] = read(addrs[i]);
+			}
+		}
+
+		// Writes values[i] to cell addrs[i], raising one event for the lot.
+		virtual void writeScatter(const int *addrs, int n, const T *values) {
+			if (n <= 0 || !isWritable())
+				return;
+			if (mem_start) {
+				for (int i=0; i<n; ++i)
+					mem_start[addrs[i] * stride] = values[i];
+				signalDMAWrite(addrs, n);
+			} else {
+				beginWrite();
+				for (int i=0; i<n; ++i)
+					write(addrs[i], values[i]);
+				commitWrite();
+			}
+		}
+
+		// For writes made straight through getWritableSpan(): reports n cells from start as written.
+		void notifyDMAWrite(std::size_t start, std::size_t n) {
+			signalDMAWrite(start, n, 1);
+		}
+
+		void readRow(std::size_t row, T *out) const {
+			readBlock(width() * row, width(), out);
+		}
+
+		void writeRow(std::size_t row, const T *in) {
+			writeBlock(width() * row, width(), in);
+		}
+
+		void readColumn(std::size_t col, T *out) const {
+			readBlock(col, height(), out, width());
+		}
+
+		void writeColumn(std::size_t col, const T *in) {
+			writeBlock(col, height(), in, width());
+		}
+
+		// Copies the w x h cells with their top left corner at (x, y) into out, row by row.
+		void readRect(std::size_t x, std::size_t y, std::size_t w, std::size_t h, T *out) const {
+			if (w == width())
+				return readBlock(width() * y, w * h, out);
+			for (std::size_t row=0; row<h; ++row)
+				readBlock(width() * (y + row) + x, w, out + w * row);
+		}
+
+		// Counterpart to readRect. Raises a single write event for the rectangle.
+		void writeRect(std::size_t x, std::size_t y, std::size_t w, std::size_t h, const T *in) {
+			if (w == width())
+				return writeBlock(width() * y, w * h, in);
+			beginWrite();
+			for (std::size_t row=0; row<h; ++row)
+				writeBlock(width() * (y + row) + x, w, in + w * row);
+			commitWrite();
+		}
+
+		void readAll(T *out) const {
+			readBlock(0, count, out);
+		}
+
+		void writeAll(const T *in) {
+			writeBlock(0, count, in);
+		}
+
+		std::size_t size() const {
+			return count;
+		}
+		
+		std::size_t width() const {
+			if (columns == 0)
+				return count;
+			else
+				return columns;
+		}
+
+		std::size_t height() const {
+			if (columns == 0)
+				return 1;
+			else
+				return count / columns;
+		}
+
+		DMAHost<T> *getOwner() const {
+			return owner;
+		}
+
+#ifdef SPARKETTE_DMA_PROFILE
+		DMAProfile &getDMAProfile() {
+			return profile;
+		}
+#endif
+
+		// Bumped on every write, so clients can cache whatever they derive from the contents.
+		virtual uint64_t getDMAVersion() const {
+			return version;
+		}
+
+		// Cells per allocated page, for channels whose unpopulated pages read as zero.
+		virtual std::size_t getDMAPageSize() const {
+			return count;
+		}
+
+		virtual bool isDMAPagePopulated(std::size_t page) const {
+			return true;
+		}
+
+		virtual DMAChannelInfo getDMAInfo() const {
+			DMAChannelInfo info;
+			info.type = DMAElementTraits<T>::type();
+			info.width = width();
+			info.height = height();
+			info.writable = isWritable();
+			info.min_value = DMAElementTraits<T>::minValue();
+			info.max_value = DMAElementTraits<T>::maxValue();
+			if (mem_start) {
+				info.features |= DMAChannelInfo::DIRECT;
+				info.stride = stride;
+				if (stride == 1)
+					info.features |= DMAChannelInfo::CONTIGUOUS;
+			}
+			if (getDMAPageSize() < count)
+				info.features |= DMAChannelInfo::SPARSE;
+			if (owner && owner->getDMACommandQueue())
+				info.features |= DMAChannelInfo::QUEUED;
+			return info;
+		}
+
+		// The channel version as of the last write to the given row.
+		virtual uint64_t getDMARowVersion(std::size_t row) const {
+			return row < row_versions.size() ? row_versions[row] : version;
+		}
+
+		// For hosts changing channel memory themselves: advances the row versions without an event.
+		void markDMAChanged(std::size_t row, std::size_t rows = 1) {
+			if (rows > 0)
+				bumpDMAVersion(row, row + rows - 1);
+		}
+
+		accessor operator[](std::size_t index) {
+			accessor acc;
+			acc.channel = this;
+			acc.index = index;
+			return acc;
+		}
+
+		T operator[](std::size_t index) const {
+			return read(index);
+		}
+	};
+
+	// Triple buffer showing a channel on the UI thread, copied only when the UI asks; neither side waits.
+	template <typename T>
+	class DMASnapshot {
+		static constexpr int FRESH = 4;
+
+		struct Frame {
+			DMABuffer<T> values;
+			std::size_t width = 0;
+			std::size_t height = 0;
+		};
+		Frame frames[3];
+		std::atomic<int> middle; // Index of the shared frame, plus FRESH if the UI hasn't taken it
+		std::atomic<bool> requested;
+		int back = 0; // Audio thread only
+		int front = 2; // UI thread only
+		uint64_t published_version = ~(uint64_t)0;
+
+	public:
+		DMASnapshot() : middle(1), requested(false) {}
+
+		DMASnapshot(const DMASnapshot &other) = delete;
+		DMASnapshot& operator=(const DMASnapshot &other) = delete;
+
+		// Audio thread. beginPublish() and endPublish() bracket filling the buffer directly.
+		bool isRequested() const {
+			return requested.load(std::memory_order_relaxed);
+		}
+
+		T *beginPublish(std::size_t width, std::size_t height) {
+			Frame &frame = frames[back];
+			frame.width = width;
+			frame.height = height;
+			return frame.values.get(width * height);
+		}
+
+		void endPublish() {
+			requested.store(false, std::memory_order_relaxed);
+			back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+		}
+
+		// Copies the channel if the UI asked for a copy and the channel has changed since the last one.
+		void publish(const DMAChannel<T> &channel) {
+			if (!isRequested())
+				return;
+			uint64_t version = channel.getDMAVersion();
+			if (version == published_version)
+				return;
+			published_version = version;
+			channel.readAll(beginPublish(channel.width(), channel.height()));
+			endPublish();
+		}
+
+		// UI thread. Asks for a copy and returns true if a newer one has arrived since the last call.
+		bool update() {
+			requested.store(true, std::memory_order_relaxed);
+			if (!(middle.load(std::memory_order_relaxed) & FRESH))
+				return false;
+			front = middle.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+			return true;
+		}
+
+		std::size_t width() const {
+			return frames[front].width;
+		}
+
+		std::size_t height() const {
+			return frames[front].height;
+		}
+
+		// Valid until the next update(); null before the first copy arrives.
+		const T *data() const {
+			return frames[front].values.data();
+		}
+
+		T get(std::size_t col, std::size_t row) const {
+			return data()[frames[front].width * row + col];
+		}
+	};
+
+	// Image of a channel's memory for the undo history, one page per row, shared between images.
+	template <typename T>
+	class DMAPages {
+		std::size_t cols = 0;
+		std::vector<std::shared_ptr<const T>> pages;
+
+	public:
+		DMAPages() = default;
+		DMAPages(std::size_t cols, std::size_t rows) : cols(cols), pages(rows) {}
+
+		std::size_t width() const {
+			return cols;
+		}
+
+		std::size_t height() const {
+			return pages.size();
+		}
+
+		const T *getRow(std::size_t row) const {
+			return pages[row].get();
+		}
+
+		void setRow(std::size_t row, const std::shared_ptr<const T> &page) {
+			pages[row] = page;
+		}
+
+		// True if both images hold the same pages.
+		bool operator==(const DMAPages &other) const {
+			return cols == other.cols && pages == other.pages;
+		}
+
+		bool operator!=(const DMAPages &other) const {
+			return !(*this == other);
+		}
+	};
+
+	// Undo for a host's memory, recorded on the audio thread into a preallocated pool of row pages.
+	template <typename T>
+	class DMAUndo {
+	public:
+		typedef std::vector<DMAPages<T>> Image;
+
+		struct Step {
+			std::string name;
+			Image before, after;
+		};
+
+	private:
+		static constexpr uint32_t NO_PAGE = ~0u;
+		static constexpr int RECORDS = 4;
+
+		// A step while it lives in the pool; its state says which thread owns it.
+		enum RecordState { IDLE, OPEN, FINISHED, TAKEN, RETURNED };
+		struct Record {
+			std::atomic<int> state;
+			const char *name = nullptr;
+			std::vector<uint32_t> before, after; // Page of each row of each channel
+
+			Record() : state(IDLE) {}
+		};
+
+		std::size_t channels, cols, rows;
+		std::vector<T> page_values;
+		std::vector<uint64_t> page_serials; // Bumped whenever a page is given new contents
+		std::vector<int> page_refs; // Audio thread only
+		std::vector<uint32_t> free_pages; // Audio thread only
+		std::vector<uint32_t> live; // Audio thread only
+		std::vector<uint64_t> live_versions; // Channel row versions the live pages were read at
+		std::vector<T> row_buffer; // Audio thread only
+		Record records[RECORDS];
+		Record *open = nullptr; // Audio thread only
+		bool reopened = false; // Whether open was a finished step merged into
+		std::atomic<Image*> requested;
+		std::atomic<Image*> retired; // Applied by restore(), for the UI thread to free
+		std::vector<std::shared_ptr<const T>> copied; // UI thread only
+		std::vector<uint64_t> copied_serials; // UI thread only
+
+		T *page(uint32_t num) {
+			return &page_values[cols * num];
+		}
+
+		void retain(uint32_t num) {
+			if (num != NO_PAGE)
+				++page_refs[num];
+		}
+
+		void release(uint32_t num) {
+			if (num != NO_PAGE && --page_refs[num] == 0)
+				free_pages.push_back(num); // Never grows past the reserve
+		}
+
+		void releaseAll(std::vector<uint32_t> &pages) {
+			for (uint32_t &num : pages) {
+				release(num);
+				num = NO_PAGE;
+			}
+		}
+
+		void hold(std::vector<uint32_t> &pages) {
+			releaseAll(pages);
+			for (std::size_t n=0; n<live.size(); ++n) {
+				pages[n] = live[n];
+				retain(live[n]);
+			}
+		}
+
+		// Drops the pages of records the UI thread has finished copying.
+		void reclaim() {
+			for (Record &record : records) {
+				if (record.state.load(std::memory_order_acquire) != RETURNED)
+					continue;
+				releaseAll(record.before);
+				releaseAll(record.after);
+				record.state.store(IDLE, std::memory_order_relaxed);
+			}
+		}
+
+		// Brings the live image up to date; false if a row lacked a page or a channel changed size.
+		template <typename C>
+		bool capture(C *dma) {
+			bool complete = true;
+			for (std::size_t i=0; i<channels; ++i) {
+				if (dma[i].width() != cols || dma[i].height() != rows) {
+					complete = false;
+					continue;
+				}
+				for (std::size_t y=0; y<rows; ++y) {
+					std::size_t n = rows * i + y;
+					uint64_t version = dma[i].getDMARowVersion(y);
+					uint32_t num = live[n];
+					if (num != NO_PAGE && live_versions[n] == version)
+						continue;
+					if (num != NO_PAGE && page_refs[num] == 1) {
+						// Held by no step, so overwritten in place
+						dma[i].readRow(y, page(num));
+						++page_serials[num];
+						live_versions[n] = version;
+						continue;
+					}
+					// Rows rewritten with the same values keep sharing their page
+					dma[i].readRow(y, row_buffer.data());
+					if (num != NO_PAGE && std::equal(row_buffer.begin(), row_buffer.end(), page(num))) {
+						live_versions[n] = version;
+						continue;
+					}
+					if (free_pages.empty()) {
+						complete = false;
+						continue;
+					}
+					uint32_t fresh = free_pages.back();
+					free_pages.pop_back();
+					std::copy(row_buffer.begin(), row_buffer.end(), page(fresh));
+					++page_serials[fresh];
+					retain(fresh);
+					release(num);
+					live[n] = fresh;
+					live_versions[n] = version;
+				}
+			}
+			return complete;
+		}
+
+		// UI thread. Copies a record's pages out of the pool, reusing an earlier copy of unchanged pages.
+		Image copyImage(const std::vector<uint32_t> &pages) {
+			Image image(channels, DMAPages<T>(cols, rows));
+			for (std::size_t n=0; n<pages.size(); ++n) {
+				uint32_t num = pages[n];
+				if (num == NO_PAGE)
+					continue;
+				if (copied[num] && copied_serials[num] != page_serials[num] && std::equal(page(num), page(num) + cols, copied[num].get()))
+					copied_serials[num] = page_serials[num];
+				if (!copied[num] || copied_serials[num] != page_serials[num]) {
+					T *values = new T[cols];
+					std::copy(page(num), page(num) + cols, values);
+					copied[num] = std::shared_ptr<const T>(values, std::default_delete<const T[]>());
+					copied_serials[num] = page_serials[num];
+				}
+				image[n / rows].setRow(n % rows, copied[num]);
+			}
+			return image;
+		}
+
+	public:
+		// Sized for channels of cols x rows, with room for the live image and the steps in flight.
+		DMAUndo(int channels, std::size_t cols, std::size_t rows) : channels(channels), cols(cols), rows(rows), requested(nullptr), retired(nullptr) {
+			std::size_t count = (std::size_t)channels * rows;
+			std::size_t pool = 4 * count;
+			page_values.resize(pool * cols);
+			page_serials.assign(pool, 0);
+			page_refs.assign(pool, 0);
+			free_pages.reserve(pool);
+			for (std::size_t num=pool; num-->0;)
+				free_pages.push_back((uint32_t)num);
+			live.assign(count, (uint32_t)NO_PAGE);
+			live_versions.assign(count, 0);
+			row_buffer.resize(cols);
+			for (Record &record : records) {
+				record.before.assign(count, (uint32_t)NO_PAGE);
+				record.after.assign(count, (uint32_t)NO_PAGE);
+			}
+			copied.resize(pool);
+			copied_serials.assign(pool, 0);
+		}
+
+		~DMAUndo() {
+			delete requested.load();
+			delete retired.load();
+		}
+
+		DMAUndo(const DMAUndo &other) = delete;
+		DMAUndo& operator=(const DMAUndo &other) = delete;
+
+		// Audio thread. Called before an operation changes any of the channels.
+		template <typename C>
+		void checkpoint(C *dma, const char *name) {
+			if (open)
+				return;
+			reclaim();
+			for (Record &record : records) {
+				int finished = FINISHED;
+				if (record.state.compare_exchange_strong(finished, OPEN, std::memory_order_acquire)) {
+					open = &record;
+					reopened = true;
+					return;
+				}
+			}
+			Record *idle = nullptr;
+			for (Record &record : records) {
+				if (record.state.load(std::memory_order_relaxed) == IDLE) {
+					idle = &record;
+					break;
+				}
+			}
+			if (!idle || !capture(dma))
+				return;
+			idle->state.store(OPEN, std::memory_order_relaxed);
+			idle->name = name;
+			hold(idle->before);
+			open = idle;
+			reopened = false;
+		}
+
+		// Audio thread. Called once the operations since checkpoint() are complete.
+		template <typename C>
+		void commit(C *dma) {
+			reclaim();
+			if (!open)
+				return;
+			bool captured = capture(dma);
+			bool changed = false;
+			for (std::size_t n=0; n<live.size() && captured && !changed; ++n)
+				changed = live[n] != open->before[n];
+			if (changed || (reopened && !captured)) {
+				// A merge that can't be captured leaves the step as it was finished
+				if (captured)
+					hold(open->after);
+				open->state.store(FINISHED, std::memory_order_release);
+			} else {
+				releaseAll(open->before);
+				releaseAll(open->after);
+				open->state.store(IDLE, std::memory_order_relaxed);
+			}
+			open = nullptr;
+		}
+
+		// Audio thread. Applies a pending undo or redo with write(channel, row, values); true if there was one.
+		template <typename C, typename F>
+		bool restore(C *dma, F write) {
+			if (!requested.load(std::memory_order_relaxed) || retired.load(std::memory_order_relaxed))
+				return false;
+			Image *image = requested.exchange(nullptr, std::memory_order_acquire);
+			if (!image)
+				return false;
+			for (std::size_t i=0; i<channels && i<image->size(); ++i) {
+				const DMAPages<T> &pages = (*image)[i];
+				if (dma[i].width() != cols || pages.width() != cols || dma[i].height() != pages.height())
+					continue;
+				for (std::size_t y=0; y<pages.height(); ++y) {
+					const T *values = pages.getRow(y);
+					if (!values)
+						continue;
+					dma[i].readRow(y, row_buffer.data());
+					if (!std::equal(row_buffer.begin(), row_buffer.end(), values))
+						write((int)i, y, values);
+				}
+			}
+			retired.store(image, std::memory_order_release);
+			return true;
+		}
+
+		// UI thread.
+		Step *takeStep() {
+			if (retired.load(std::memory_order_relaxed))
+				delete retired.exchange(nullptr, std::memory_order_acquire);
+			for (Record &record : records) {
+				int finished = FINISHED;
+				if (!record.state.compare_exchange_strong(finished, TAKEN, std::memory_order_acquire))
+					continue;
+				Step *step = new Step;
+				step->name = record.name;
+				step->before = copyImage(record.before);
+				step->after = copyImage(record.after);
+				record.state.store(RETURNED, std::memory_order_release);
+				return step;
+			}
+			return nullptr;
+		}
+
+		void requestRestore(const Image &image) {
+			delete requested.exchange(new Image(image), std::memory_order_acq_rel);
+		}
+	};
+
+	// Clients cache these channels until invalidateDMAChain(); readiness is asked live.
+	template <typename T>
+	struct DMAHost {
+		virtual int getDMAChannelCount() const = 0;
+		virtual DMAChannel<T> *getDMAChannel(int num) = 0;
+		virtual const DMAChannel<T> *getDMAChannel(int num) const {
+			auto this_nonconst = const_cast<DMAHost*>(this);
+			return const_cast<const DMAChannel<T>*>(this_nonconst->getDMAChannel(num));
+		}
+		virtual bool readyForDMA() const {
+			return true;
+		}
+		// Hosts that apply client writes at a fixed point in their cycle return their queue here.
+		virtual DMACommandQueue<T> *getDMACommandQueue() {
+			return nullptr;
+		}
+		// Client thread. Queues the command, or applies it if there is no queue; false if any part was dropped.
+		virtual bool acceptDMACommand(const DMACommand<T> &command, DMAScratch<T> &scratch);
+		// Hosts that publish copies of their own memory behind a channel for the UI return them here.
+		virtual DMASnapshot<T> *getDMASnapshot(int num) {
+			return nullptr;
+		}
+		// Hosts that keep undo history for their memory return it here.
+		virtual DMAUndo<T> *getDMAUndo() {
+			return nullptr;
+		}
+		// Called before a command marked as a checkpoint changes the channel.
+		virtual void onDMACheckpoint(DMAChannel<T> *channel) {}
+		virtual void onDMAWrite(const DMAWriteEvent<T> &e) {}
+		virtual void onDMABegin(const DMATransactionEvent<T> &e) {}
+		virtual void onDMACommit(const DMATransactionEvent<T> &e) {}
+
+		unsigned getDMAGeneration() const {
+			return dma_generation.load(std::memory_order_acquire);
+		}
+
+		// Bumped by invalidateDMAChain() whenever this host's chain of expanders changes.
+		std::atomic<unsigned> dma_generation{0};
+
+#ifdef SPARKETTE_DMA_PROFILE
+		// Everything done to the channels this host owns, as counted by executeDMACommand().
+		DMAProfile dma_host_profile;
+#endif
+	};
+
+	template <typename T>
+	class DMATransaction {
+		DMAChannel<T> &channel;
+
+	public:
+		explicit DMATransaction(DMAChannel<T> &channel) : channel(channel) {
+			channel.beginWrite();
+		}
+
+		~DMATransaction() {
+			channel.commitWrite();
+		}
+
+		DMATransaction(const DMATransaction &other) = delete;
+		DMATransaction& operator=(const DMATransaction &other) = delete;
+	};
+
+	// CRTP base turning TDerived's inline get/set into statically dispatched loops behind every virtual.
+	template <typename TDerived, typename T>
+	class DMAChannelImpl : public DMAChannel<T> {
+		const TDerived &derived() const { return *static_cast<const TDerived*>(this); }
+		TDerived &derived() { return *static_cast<TDerived*>(this); }
+
+	public:
+		void setWriteEnable(bool enable) {
+			if (derived().write_enable == enable)
+				return;
+			derived().write_enable = enable;
+			this->markDMAInfoChanged();
+		}
+
+		T read(std::size_t index) const override {
+			return derived().get(index);
+		}
+
+		void write(std::size_t index, T value) override {
+			if (!derived().isWritable())
+				return;
+			derived().set(index, value);
+			this->signalDMAWrite(index);
+		}
+
+		void readBlock(std::size_t start, std::size_t n, T *out, std::size_t step = 1) const override {
+			for (std::size_t i=0; i<n; ++i)
+				out[i] = derived().get(start + i * step);
+		}
+
+		void writeBlock(std::size_t start, std::size_t n, const T *in, std::size_t step = 1) override {
+			if (n == 0 || !derived().isWritable())
+				return;
+			for (std::size_t i=0; i<n; ++i)
+				derived().set(start + i * step, in[i]);
+			this->signalDMAWrite(start, n, step);
+		}
+
+		void readGather(const int *addrs, int n, T *out) const override {
+			for (int i=0; i<n; ++i)
+				out[i] = derived().get(addrs[i]);
+		}
+
+		void writeScatter(const int *addrs, int n, const T *values) override {
+			if (n <= 0 || !derived().isWritable())
+				return;
+			for (int i=0; i<n; ++i)
+				derived().set(addrs[i], values[i]);
+			this->signalDMAWrite(addrs, n);
+		}
+	};
+
+	// Plain memory with a stride fixed at compile time, e.g. one plane of an interleaved array.
+	template <typename T, std::size_t Stride>
+	class DMAStridedChannel final : public DMAChannelImpl<DMAStridedChannel<T, Stride>, T> {
+	public:
+		bool write_enable = true;
+
+		void setup(DMAHost<T> *owner, std::size_t width, std::size_t height, T *mem_start) {
+			DMAChannel<T>::setup(owner, width, height, mem_start, Stride);
+		}
+
+		T get(std::size_t index) const {
+			return this->mem_start[index * Stride];
+		}
+
+		void set(std::size_t index, T value) {
+			this->mem_start[index * Stride] = value;
+		}
+
+		bool isWritable() const override {
+			return write_enable;
+		}
+	};
+
+	// Booleans packed 64 to a word, each row word-aligned with its padding bits kept clear.
+	class DMABitChannel final : public DMAChannelImpl<DMABitChannel, bool> {
+		uint64_t *words = nullptr;
+		std::size_t row_words = 0;
+
+	public:
+		bool write_enable = true;
+
+		static constexpr std::size_t wordsPerRow(std::size_t width) {
+			return (width + 63) / 64;
+		}
+
+		void setup(DMAHost<bool> *owner, std::size_t width, std::size_t height, uint64_t *words) {
+			DMAChannel<bool>::setup(owner, width, height);
+			this->words = words;
+			row_words = wordsPerRow(width);
+		}
+
+		bool get(std::size_t index) const {
+			std::size_t x = index % columns;
+			return (getRow(index / columns)[x / 64] >> (x % 64)) & 1;
+		}
+
+		void set(std::size_t index, bool value) {
+			std::size_t x = index % columns;
+			uint64_t bit = uint64_t(1) << (x % 64);
+			uint64_t &word = getRow(index / columns)[x / 64];
+			word = value ? (word | bit) : (word & ~bit);
+		}
+
+		bool isWritable() const override {
+			return write_enable;
+		}
+
+		DMAChannelInfo getDMAInfo() const override {
+			DMAChannelInfo info = DMAChannel<bool>::getDMAInfo();
+			info.features |= DMAChannelInfo::PACKED_BITS;
+			return info;
+		}
+
+		uint64_t *getRow(std::size_t row) const {
+			return words + row_words * row;
+		}
+
+		std::size_t getRowWords() const {
+			return row_words;
+		}
+
+		std::size_t getWordCount() const {
+			return row_words * height();
+		}
+
+		// Valid bits of the last word in each row.
+		uint64_t getLastWordMask() const {
+			std::size_t used = columns % 64;
+			return used ? (uint64_t(1) << used) - 1 : ~uint64_t(0);
+		}
+
+		void clearPadding() {
+			uint64_t mask = getLastWordMask();
+			for (std::size_t y=0; y<height(); ++y)
+				getRow(y)[row_words - 1] &= mask;
+		}
+
+		// For words modified directly: restores the padding invariant and reports every cell as written.
+		void commitWords() {
+			clearPadding();
+			notifyDMAWrite(0, count);
+		}
+	};
+
+	// Shifts a packed row towards higher columns by n bits (lower if negative), zero filling; src != dest.
+	inline void dmaShiftBits(const uint64_t *src, uint64_t *dest, std::size_t words, std::ptrdiff_t n) {
+		std::size_t distance = (std::size_t)(n < 0 ? -n : n);
+		std::size_t q = distance / 64;
+		unsigned r = (unsigned)(distance % 64);
+		for (std::size_t i=0; i<words; ++i) {
+			uint64_t word = 0;
+			if (n >= 0) {
+				if (i >= q)
+					word |= src[i - q] << r;
+				if (r && i >= q + 1)
+					word |= src[i - q - 1] >> (64 - r);
+			} else {
+				if (i + q < words)
+					word |= src[i + q] >> r;
+				if (r && i + q + 1 < words)
+					word |= src[i + q + 1] << (64 - r);
+			}
+			dest[i] = word;
+		}
+	}
+
+	inline uint64_t dmaReverseBits(uint64_t w) {
+		w = ((w >> 1) & 0x5555555555555555ull) | ((w & 0x5555555555555555ull) << 1);
+		w = ((w >> 2) & 0x3333333333333333ull) | ((w & 0x3333333333333333ull) << 2);
+		w = ((w >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((w & 0x0F0F0F0F0F0F0F0Full) << 4);
+		w = ((w >> 8) & 0x00FF00FF00FF00FFull) | ((w & 0x00FF00FF00FF00FFull) << 8);
+		w = ((w >> 16) & 0x0000FFFF0000FFFFull) | ((w & 0x0000FFFF0000FFFFull) << 16);
+		return (w >> 32) | (w << 32);
+	}
+
+	// Memory allocated a page at a time on first write; pages are published with a compare-and-swap.
+	template <typename T, std::size_t PageBits = 12>
+	class DMASparseChannel final : public DMAChannelImpl<DMASparseChannel<T, PageBits>, T> {
+		std::unique_ptr<std::atomic<T*>[]> pages;
+		std::size_t page_count = 0;
+		std::atomic<std::size_t> populated{0};
+		std::vector<T*> retired; // Emptied by clear(), host thread only
+		int64_t retired_frame = -1;
+
+		static std::size_t pageSize() {
+			return (std::size_t)1 << PageBits;
+		}
+
+		const T *getPage(std::size_t num) const {
+			return pages[num].load(std::memory_order_acquire);
+		}
+
+		void freePages() {
+			for (std::size_t num=0; num<page_count; ++num)
+				delete[] pages[num].load(std::memory_order_relaxed);
+			for (T *page : retired)
+				delete[] page;
+			retired.clear();
+		}
+
+	public:
+		bool write_enable = true;
+
+		DMASparseChannel() = default;
+		DMASparseChannel(const DMASparseChannel &other) = delete;
+		DMASparseChannel& operator=(const DMASparseChannel &other) = delete;
+
+		~DMASparseChannel() {
+			freePages();
+		}
+
+		void setup(DMAHost<T> *owner, std::size_t width, std::size_t height) {
+			DMAChannel<T>::setup(owner, width, height);
+			freePages();
+			page_count = (width * height + pageSize() - 1) >> PageBits;
+			pages.reset(new std::atomic<T*>[page_count]);
+			for (std::size_t num=0; num<page_count; ++num)
+				pages[num].store(nullptr, std::memory_order_relaxed);
+			populated.store(0, std::memory_order_relaxed);
+			retired.reserve(page_count);
+		}
+
+		T get(std::size_t index) const {
+			const T *page = getPage(index >> PageBits);
+			return page ? page[index & (pageSize() - 1)] : T(0);
+		}
+
+		void set(std::size_t index, T value) {
+			std::atomic<T*> &slot = pages[index >> PageBits];
+			T *page = slot.load(std::memory_order_acquire);
+			if (!page) {
+				if (value == T(0))
+					return;
+				T *fresh = new T[pageSize()]();
+				if (slot.compare_exchange_strong(page, fresh, std::memory_order_acq_rel)) {
+					page = fresh;
+					populated.fetch_add(1, std::memory_order_relaxed);
+				} else {
+					delete[] fresh; // Another thread got there first
+				}
+			}
+			page[index & (pageSize() - 1)] = value;
+		}
+
+		bool isWritable() const override {
+			return write_enable;
+		}
+
+		// Contiguous reads copy or zero a page at a time.
+		void readBlock(std::size_t start, std::size_t n, T *out, std::size_t step = 1) const override {
+			if (step != 1)
+				return DMAChannelImpl<DMASparseChannel, T>::readBlock(start, n, out, step);
+			while (n > 0) {
+				std::size_t offset = start & (pageSize() - 1);
+				std::size_t len = std::min(n, pageSize() - offset);
+				const T *page = getPage(start >> PageBits);
+				if (page)
+					std::copy(page + offset, page + offset + len, out);
+				else
+					std::fill(out, out + len, T(0));
+				start += len;
+				out += len;
+				n -= len;
+			}
+		}
+
+		std::size_t getDMAPageSize() const override {
+			return pageSize();
+		}
+
+		bool isDMAPagePopulated(std::size_t page) const override {
+			return page < page_count && getPage(page);
+		}
+
+		std::size_t getPopulatedPageCount() const {
+			return populated.load(std::memory_order_relaxed);
+		}
+
+		std::size_t getMemoryUsage() const {
+			return getPopulatedPageCount() * pageSize() * sizeof(T);
+		}
+
+		// Host thread. Empties every page; the old pages are freed by a later reclaim().
+		void clear() {
+			for (std::size_t num=0; num<page_count; ++num) {
+				if (T *page = pages[num].exchange(nullptr, std::memory_order_acq_rel)) {
+					retired.push_back(page);
+					populated.fetch_sub(1, std::memory_order_relaxed);
+				}
+			}
+			retired_frame = -1;
+			this->notifyDMAWrite(0, this->size());
+		}
+
+		// Host thread, once per frame. Frees emptied pages once no client can still be reading them.
+		void reclaim(int64_t frame) {
+			if (retired.empty())
+				return;
+			if (retired_frame < 0)
+				retired_frame = frame;
+			else if (frame >= retired_frame + 2) {
+				for (T *page : retired)
+					delete[] page;
+				retired.clear();
+			}
+		}
+	};
+
+	// Element access over memory with a known layout. Stride 0 means the stride is only known at runtime.
+	template <typename T, std::size_t Stride>
+	struct DMADirectView {
+		T *ptr;
+		std::size_t count;
+		std::size_t columns;
+		std::size_t stride;
+
+		T &at(std::size_t offset) const {
+			return ptr[offset * (Stride ? Stride : stride)];
+		}
+
+		T get(std::size_t index) const {
+			return at(index);
+		}
+
+		void set(std::size_t index, T value) const {
+			at(index) = value;
+		}
+
+		T get(std::size_t col, std::size_t row) const {
+			return at(columns * row + col);
+		}
+
+		void set(std::size_t col, std::size_t row, T value) const {
+			at(columns * row + col) = value;
+		}
+
+		void swap(std::size_t col1, std::size_t row1, std::size_t col2, std::size_t row2) const {
+			T &a = at(columns * row1 + col1);
+			T &b = at(columns * row2 + col2);
+			T temp = a;
+			a = b;
+			b = temp;
+		}
+
+		std::size_t size() const { return count; }
+		std::size_t width() const { return columns; }
+		std::size_t height() const { return count / columns; }
+	};
+
+	// Runs func on a DMADirectView of the whole channel in one transaction, in place when possible.
+	template <typename T, typename F>
+	void modifyDMAChannel(DMAChannel<T> &channel, DMABuffer<T> &scratch, F &&func) {
+		DMATransaction<T> transaction(channel);
+		std::size_t count = channel.size();
+		std::size_t columns = channel.width();
+		DMASpan<T> span = channel.getWritableSpan();
+		if (span) {
+			switch (span.stride) {
+				case 1: func(DMADirectView<T, 1>{span.ptr, count, columns, 1}); break;
+				case 4: func(DMADirectView<T, 4>{span.ptr, count, columns, 4}); break;
+				default: func(DMADirectView<T, 0>{span.ptr, count, columns, span.stride}); break;
+			}
+			channel.notifyDMAWrite(0, count);
+		} else if (channel.isWritable()) {
+			T *buffer = scratch.get(count);
+			channel.readAll(buffer);
+			func(DMADirectView<T, 1>{buffer, count, columns, 1});
+			channel.writeAll(buffer);
+		}
+	}
+
+	// Whole-channel operations as data, so they can be queued or run directly. Rotations need a square.
+	struct DMATransform {
+		enum Type {
+			SCROLL,
+			FLIP_V,
+			FLIP_H,
+			ROTATE_CW,
+			ROTATE_CCW,
+			INVERT,
+			RANDOMIZE
+		};
+		Type type = SCROLL;
+		int dx = 0;
+		int dy = 0;
+		bool wrap = false;
+		float offset = 0.f; // Inversion offset, or random minimum
+		float scale = 0.f; // Random range
+
+		DMATransform() = default;
+		DMATransform(Type type) : type(type) {}
+	};
+
+	template <typename T>
+	struct DMAScratch {
+		DMABuffer<T> src, dest;
+		DMABuffer<uint64_t> words;
+	};
+
+	inline float dmaInvertValue(float value, float offset) {
+		return offset - value;
+	}
+
+	inline bool dmaInvertValue(bool value, float) {
+		return !value;
+	}
+
+	// The element type is picked by the (unused) pointer argument.
+	inline float dmaRandomValue(const float *, float offset, float scale) {
+		return offset + random::uniform() * scale;
+	}
+
+	inline bool dmaRandomValue(const bool *, float offset, float) {
+		return 20.f * (random::uniform() - 0.5f) < offset;
+	}
+
+	// In-place operations for modifyDMAChannel, as functors so they instantiate per view stride.
+	struct DMAFlipV {
+		template <typename V>
+		void operator()(const V &v) const {
+			std::size_t cols = v.width(), rows = v.height();
+			for (std::size_t y=0; y<rows/2; ++y)
+				for (std::size_t x=0; x<cols; ++x)
+					v.swap(x, y, x, rows-1-y);
+		}
+	};
+
+	struct DMAFlipH {
+		template <typename V>
+		void operator()(const V &v) const {
+			std::size_t cols = v.width(), rows = v.height();
+			for (std::size_t y=0; y<rows; ++y)
+				for (std::size_t x=0; x<cols/2; ++x)
+					v.swap(x, y, cols-1-x, y);
+		}
+	};
+
+	struct DMATranspose {
+		template <typename V>
+		void operator()(const V &v) const {
+			std::size_t n = v.width();
+			for (std::size_t y=0; y<n; ++y)
+				for (std::size_t x=y+1; x<n; ++x)
+					v.swap(x, y, y, x);
+		}
+	};
+
+	// Rotation is a transpose followed by a flip.
+	struct DMARotateCW {
+		template <typename V>
+		void operator()(const V &v) const {
+			DMATranspose()(v);
+			DMAFlipH()(v);
+		}
+	};
+
+	struct DMARotateCCW {
+		template <typename V>
+		void operator()(const V &v) const {
+			DMATranspose()(v);
+			DMAFlipV()(v);
+		}
+	};
+
+	struct DMAInvert {
+		float offset;
+		template <typename V>
+		void operator()(const V &v) const {
+			for (std::size_t y=0; y<v.height(); ++y)
+				for (std::size_t x=0; x<v.width(); ++x)
+					v.set(x, y, dmaInvertValue(v.get(x, y), offset));
+		}
+	};
+
+	// Word-at-a-time versions for bit-packed channels. Each finishes with commitWords().
+	inline void dmaScrollBits(DMABitChannel &dma, int dx, int dy, bool wrap, DMABuffer<uint64_t> &scratch) {
+		int cols = (int)dma.width(), rows = (int)dma.height();
+		std::size_t rw = dma.getRowWords();
+		uint64_t *src = scratch.get(rw * (rows + 1));
+		uint64_t *tmp = src + rw * rows;
+		std::copy(dma.getRow(0), dma.getRow(rows), src);
+		if (wrap)
+			dx = (dx % cols + cols) % cols;
+		for (int y = 0; y < rows; ++y) {
+			uint64_t *destRow = dma.getRow(y);
+			int srcY = y - dy;
+			if (srcY < 0 || srcY >= rows) {
+				if (!wrap) {
+					std::fill(destRow, destRow + rw, 0);
+					continue;
+				}
+				srcY = (srcY % rows + rows) % rows;
+			}
+			const uint64_t *srcRow = src + rw * srcY;
+			dmaShiftBits(srcRow, destRow, rw, dx);
+			if (wrap && dx) {
+				dmaShiftBits(srcRow, tmp, rw, dx - cols);
+				for (std::size_t i = 0; i < rw; ++i)
+					destRow[i] |= tmp[i];
+			}
+		}
+		dma.commitWords();
+	}
+
+	inline void dmaFlipVBits(DMABitChannel &dma) {
+		std::size_t rows = dma.height(), rw = dma.getRowWords();
+		for (std::size_t y=0; y<rows/2; ++y)
+			std::swap_ranges(dma.getRow(y), dma.getRow(y) + rw, dma.getRow(rows-1-y));
+		dma.commitWords();
+	}
+
+	// Reversing a row's words and bits mirrors it; shifting back by the padding realigns it.
+	inline void dmaFlipHBits(DMABitChannel &dma, DMABuffer<uint64_t> &scratch) {
+		std::size_t rw = dma.getRowWords();
+		std::ptrdiff_t padding = (std::ptrdiff_t)(64 * rw - dma.width());
+		uint64_t *tmp = scratch.get(rw);
+		for (std::size_t y=0; y<dma.height(); ++y) {
+			uint64_t *row = dma.getRow(y);
+			for (std::size_t i=0; i<rw; ++i)
+				tmp[i] = dmaReverseBits(row[rw-1-i]);
+			dmaShiftBits(tmp, row, rw, -padding);
+		}
+		dma.commitWords();
+	}
+
+	inline void dmaInvertBits(DMABitChannel &dma) {
+		uint64_t *words = dma.getRow(0);
+		for (std::size_t i=0; i<dma.getWordCount(); ++i)
+			words[i] = ~words[i];
+		dma.commitWords();
+	}
+
+	// Sets each bit with probability p (in 1/256 steps) by folding eight draws per word with OR and AND.
+	inline void dmaRandomizeBits(DMABitChannel &dma, float p) {
+		int q = (int)std::round(std::max(0.f, std::min(1.f, p)) * 256.f);
+		uint64_t *words = dma.getRow(0);
+		for (std::size_t i=0; i<dma.getWordCount(); ++i) {
+			uint64_t word = 0;
+			if (q >= 256)
+				word = ~word;
+			else if (q > 0) {
+				for (int b=0; b<8; ++b)
+					word = ((q >> b) & 1) ? (word | random::u64()) : (word & random::u64());
+			}
+			words[i] = word;
+		}
+		dma.commitWords();
+	}
+
+	// Calls func(start, n) for each run of cells in populated pages of the channel.
+	template <typename T, typename F>
+	void forEachPopulatedDMARange(const DMAChannel<T> &dma, F func) {
+		std::size_t count = dma.size();
+		std::size_t page_size = dma.getDMAPageSize();
+		if (page_size == 0)
+			return;
+		std::size_t start = 0, n = 0;
+		for (std::size_t begin=0, page=0; begin<count; begin+=page_size, ++page) {
+			if (dma.isDMAPagePopulated(page)) {
+				if (n == 0)
+					start = begin;
+				n += std::min(page_size, count - begin);
+			} else if (n > 0) {
+				func(start, n);
+				n = 0;
+			}
+		}
+		if (n > 0)
+			func(start, n);
+	}
+
 	template <typename T>
-	struct DMAWriteEvent {
-		DMAChannel<T> *channel;
-		std::size_t index;
-	};
+	bool isDMASparse(const DMAChannel<T> &dma) {
+		return dma.getDMAPageSize() < dma.size();
+	}
 
+	inline bool isDMASparse(const DMAChannel<bool> &) {
+		return false; // Inverting false gives true, so empty pages can't be skipped
+	}
+
+	// Negating zero gives zero, so on a sparse channel -x only has to visit populated pages.
 	template <typename T>
-	class DMAHost;
-	
+	void dmaInvertPopulated(DMAChannel<T> &dma, DMAScratch<T> &scratch) {
+		DMATransaction<T> transaction(dma);
+		forEachPopulatedDMARange(dma, [&](std::size_t start, std::size_t n) {
+			T *values = scratch.src.get(n);
+			dma.readBlock(start, n, values);
+			for (std::size_t i=0; i<n; ++i)
+				values[i] = dmaInvertValue(values[i], 0.f);
+			dma.writeBlock(start, n, values);
+		});
+	}
+
 	template <typename T>
-	class DMAChannel {
-	protected:
-		T *mem_start = nullptr;
-		DMAHost<T> *owner = nullptr;
-		std::size_t count = 0;
-		std::size_t stride = 1;
-		std::size_t columns = 1;
+	DMABitChannel *getDMABits(DMAChannel<T> &) {
+		return nullptr;
+	}
 
-		void signalDMAWrite(std::size_t index) {
-			if (owner) {
-				DMAWriteEvent<T> e;
-				e.channel = this;
-				e.index = index;
-				owner->onDMAWrite(e);
+	inline DMABitChannel *getDMABits(DMAChannel<bool> &dma) {
+		DMABitChannel *bits = dynamic_cast<DMABitChannel *>(&dma);
+		return (bits && bits->isWritable()) ? bits : nullptr;
+	}
+
+	// Scrolling reads and writes the whole channel as one block each, so the host sees one event.
+	template <typename T>
+	void dmaScroll(DMAChannel<T> &dma, int dx, int dy, bool wrap, DMAScratch<T> &scratch) {
+		std::size_t count = dma.size();
+		int cols = (int)dma.width(), rows = (int)dma.height();
+		T *src = scratch.src.get(count);
+		T *dest = scratch.dest.get(count);
+		DMATransaction<T> transaction(dma);
+		dma.readAll(src);
+		for (int y = 0; y < rows; ++y) {
+			int srcY = y - dy;
+			if (srcY < 0 || srcY >= rows) {
+				if (!wrap) {
+					std::fill(dest + cols * y, dest + cols * (y + 1), T(0)); // Zero out pixels that scroll beyond the edge
+					continue;
+				}
+				srcY = (srcY % rows + rows) % rows;
+			}
+			const T *srcRow = src + cols * srcY;
+			T *destRow = dest + cols * y;
+			for (int x = 0; x < cols; ++x) {
+				int srcX = x - dx;
+				if (srcX < 0 || srcX >= cols) {
+					if (!wrap) {
+						destRow[x] = T(0);
+						continue;
+					}
+					srcX = (srcX % cols + cols) % cols;
+				}
+				destRow[x] = srcRow[srcX];
 			}
 		}
+		dma.writeAll(dest);
+	}
 
-	public:
-		class accessor {
-			friend class DMAChannel<T>;
-			DMAChannel *channel;
-			std::size_t index;
-		public:
-			operator T() const { return channel->read(index); }
-			accessor& operator=(T rhs) {
-				channel->write(index, rhs);
-				return *this;
-			}
+	template <typename T>
+	void dmaRandomize(DMAChannel<T> &dma, float offset, float scale, DMAScratch<T> &scratch) {
+		std::size_t count = dma.size();
+		T *values = scratch.dest.get(count);
+		for (std::size_t i=0; i<count; ++i)
+			values[i] = dmaRandomValue(values, offset, scale);
+		dma.writeAll(values);
+	}
+
+	template <typename T>
+	void applyDMATransform(DMAChannel<T> &dma, const DMATransform &op, DMAScratch<T> &scratch) {
+		DMABitChannel *bits = getDMABits(dma);
+		switch (op.type) {
+			case DMATransform::SCROLL:
+				if (bits)
+					dmaScrollBits(*bits, op.dx, op.dy, op.wrap, scratch.words);
+				else
+					dmaScroll(dma, op.dx, op.dy, op.wrap, scratch);
+				break;
+			case DMATransform::FLIP_V:
+				if (bits)
+					dmaFlipVBits(*bits);
+				else
+					modifyDMAChannel(dma, scratch.src, DMAFlipV());
+				break;
+			case DMATransform::FLIP_H:
+				if (bits)
+					dmaFlipHBits(*bits, scratch.words);
+				else
+					modifyDMAChannel(dma, scratch.src, DMAFlipH());
+				break;
+			case DMATransform::ROTATE_CW:
+				modifyDMAChannel(dma, scratch.src, DMARotateCW());
+				break;
+			case DMATransform::ROTATE_CCW:
+				modifyDMAChannel(dma, scratch.src, DMARotateCCW());
+				break;
+			case DMATransform::INVERT:
+				if (bits)
+					dmaInvertBits(*bits);
+				else if (op.offset == 0.f && isDMASparse(dma))
+					dmaInvertPopulated(dma, scratch);
+				else
+					modifyDMAChannel(dma, scratch.src, DMAInvert{op.offset});
+				break;
+			case DMATransform::RANDOMIZE:
+				if (bits)
+					dmaRandomizeBits(*bits, op.offset / 20.f + 0.5f);
+				else
+					dmaRandomize(dma, op.offset, op.scale, scratch);
+				break;
+		}
+	}
+
+	// An operation on a host's memory, queued for it to apply. Buffers are the client's until isDMACommandDone().
+	template <typename T>
+	struct DMACommand {
+		enum Type {
+			WRITE, // values[i] to addresses[i]
+			FILL, // values[0] to count cells from addresses[0]
+			TRANSFORM,
+			READ, // The cells at addresses into target
+			READ_BLOCK, // count cells from addresses[0] into target
+			WRITE_BLOCK // count cells from addresses[0] out of source
 		};
+		Type type = WRITE;
+		DMAChannel<T> *channel = nullptr;
+		int64_t frame = 0; // Engine frame the command was issued in
+		unsigned generation = 0; // Of the host whose queue it went into, set by push()
+		int count = 0;
+		int width = 0; // Makes a block a rectangle this wide, with its top left cell at addresses[0]
+		int addresses[PORT_MAX_CHANNELS];
+		T values[PORT_MAX_CHANNELS];
+		DMATransform transform;
+		T *target = nullptr;
+		const T *source = nullptr;
+#ifdef SPARKETTE_DMA_PROFILE
+		DMAProfile *issuer = nullptr; // Charged with the command's cost when profiling
+#endif
+		bool checkpoint = false; // A user-visible operation the host may record for undo
 
-		void setup(DMAHost<T> *owner, std::size_t count, T *mem_start = nullptr, std::size_t stride = 1) {
-			this->owner = owner;
-			this->count = count;
-			this->mem_start = mem_start;
-			this->stride = stride;
-			columns = 1;
+		bool isWrite() const {
+			return type != READ && type != READ_BLOCK;
 		}
+	};
 
-		void setup(DMAHost<T> *owner, std::size_t width, std::size_t height, T *mem_start = nullptr, std::size_t stride = 1) {
-			setup(owner, width * height, mem_start, stride);
-			columns = width;
+	// A command is applied in the frame after it was issued, so two frames on its buffers are free.
+	inline bool isDMACommandDone(int64_t issued, int64_t frame) {
+		return frame >= issued + 2;
+	}
+
+#ifdef SPARKETTE_DMA_PROFILE
+	// Charges a command's cells, bytes and time to its channel, the channel's owner and whoever issued it.
+	template <typename T>
+	struct DMACommandProfiler {
+		const DMACommand<T> &command;
+		bool active;
+		int64_t start;
+
+		explicit DMACommandProfiler(const DMACommand<T> &command) : command(command), active(isDMAProfiling()), start(active ? getDMAProfileClock() : 0) {}
+
+		~DMACommandProfiler() {
+			if (!active)
+				return;
+			uint64_t elapsed = (uint64_t)(getDMAProfileClock() - start);
+			DMAHost<T> *owner = command.channel->getOwner();
+			DMAProfile *profiles[] = {&command.channel->getDMAProfile(), owner ? &owner->dma_host_profile : nullptr, command.issuer};
+			uint64_t cells = (command.type == DMACommand<T>::TRANSFORM) ? command.channel->size() : (uint64_t)command.count;
+			for (DMAProfile *profile : profiles) {
+				if (!profile)
+					continue;
+				profile->add(command.isWrite() ? profile->writes : profile->reads, cells);
+				if (command.type != DMACommand<T>::WRITE && command.type != DMACommand<T>::READ)
+					profile->add(profile->bytes, cells * sizeof(T));
+				profile->add(profile->nanoseconds, elapsed);
+			}
 		}
+	};
+#endif
 
-		DMAChannel() = default;
-		DMAChannel(DMAHost<T> *owner, T *mem_start, std::size_t count, std::size_t columns = 1, std::size_t stride = 1)
-			: owner(owner), mem_start(mem_start), count(count), stride(stride), columns(columns) {}
-		DMAChannel(const DMAChannel& other) = delete;
-		DMAChannel& operator=(const DMAChannel& other) = delete;
+	template <typename T>
+	void executeDMACommand(const DMACommand<T> &command, DMAScratch<T> &scratch) {
+#ifdef SPARKETTE_DMA_PROFILE
+		DMACommandProfiler<T> profiler(command);
+#endif
+		DMAChannel<T> &dma = *command.channel;
+		if (command.checkpoint && dma.getOwner())
+			dma.getOwner()->onDMACheckpoint(&dma);
+		switch (command.type) {
+			case DMACommand<T>::WRITE:
+				dma.writeScatter(command.addresses, command.count, command.values);
+				break;
+			case DMACommand<T>::FILL: {
+				T *values = scratch.dest.get(command.count);
+				std::fill(values, values + command.count, command.values[0]);
+				dma.writeBlock(command.addresses[0], command.count, values);
+				break;
+			}
+			case DMACommand<T>::TRANSFORM:
+				applyDMATransform(dma, command.transform, scratch);
+				break;
+			case DMACommand<T>::READ:
+				dma.readGather(command.addresses, command.count, command.target);
+				break;
+			case DMACommand<T>::READ_BLOCK:
+				if (command.width > 0)
+					dma.readRect(command.addresses[0] % dma.width(), command.addresses[0] / dma.width(), command.width, command.count / command.width, command.target);
+				else
+					dma.readBlock(command.addresses[0], command.count, command.target);
+				break;
+			case DMACommand<T>::WRITE_BLOCK:
+				if (command.width > 0)
+					dma.writeRect(command.addresses[0] % dma.width(), command.addresses[0] / dma.width(), command.width, command.count / command.width, command.source);
+				else
+					dma.writeBlock(command.addresses[0], command.count, command.source);
+				break;
+		}
+	}
 
-		virtual T read(std::size_t index) const {
-			return mem_start[index * stride];
+	// Bounded multi-producer, single-consumer queue (after Vyukov), drained by the host in process().
+	template <typename T>
+	class DMACommandQueue {
+	public:
+		static constexpr std::size_t CAPACITY = 256;
+
+	private:
+		static constexpr int MAX_OPEN_CHANNELS = 32;
+
+		struct Slot {
+			std::atomic<std::size_t> sequence;
+			DMACommand<T> command;
+		};
+		// Keeps the producers' tail off the host thread's cache line.
+		std::atomic<std::size_t> tail;
+		char tail_padding[64 - sizeof(std::atomic<std::size_t>)];
+		std::size_t head = 0;
+		DMAScratch<T> scratch;
+		Slot slots[CAPACITY];
+
+	public:
+		DMACommandQueue() : tail(0) {
+			for (std::size_t i=0; i<CAPACITY; ++i)
+				slots[i].sequence.store(i, std::memory_order_relaxed);
 		}
 
-		T read(std::size_t col, std::size_t row) const {
-			return read(columns * row + col);
+		DMACommandQueue(const DMACommandQueue &other) = delete;
+		DMACommandQueue& operator=(const DMACommandQueue &other) = delete;
+
+		// Returns false if the queue is full. generation is the host's current one.
+		bool push(const DMACommand<T> &command, unsigned generation) {
+			std::size_t pos = tail.load(std::memory_order_relaxed);
+			for (;;) {
+				Slot &slot = slots[pos % CAPACITY];
+				std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+				if (diff == 0) {
+					if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						slot.command = command;
+						slot.command.generation = generation;
+						slot.sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = tail.load(std::memory_order_relaxed);
+				}
+			}
 		}
 
-		virtual void write(std::size_t index, T value) {
-			mem_start[index * stride] = value;
-			signalDMAWrite(index);
+		// Applies commands issued before frame, one transaction per channel; older generations are dropped.
+		void apply(int64_t frame, unsigned generation) {
+			DMAChannel<T> *open[MAX_OPEN_CHANNELS];
+			int nopen = 0;
+			for (;;) {
+				Slot &slot = slots[head % CAPACITY];
+				if (slot.sequence.load(std::memory_order_acquire) != head + 1)
+					break;
+				const DMACommand<T> &command = slot.command;
+				if (command.frame >= frame)
+					break;
+				if (command.generation == generation) {
+					DMAChannel<T> *channel = command.channel;
+					if (command.isWrite() && nopen < MAX_OPEN_CHANNELS && std::find(open, open + nopen, channel) == open + nopen) {
+						channel->beginWrite();
+						open[nopen++] = channel;
+					}
+					executeDMACommand(command, scratch);
+				}
+				slot.sequence.store(head + CAPACITY, std::memory_order_release);
+				++head;
+			}
+			for (int i=0; i<nopen; ++i)
+				open[i]->commitWrite();
 		}
+	};
 
-		void write(std::size_t col, std::size_t row, T value) {
-			write(columns * row + col, value);
+	template <typename T>
+	bool DMAHost<T>::acceptDMACommand(const DMACommand<T> &command, DMAScratch<T> &scratch) {
+		DMACommandQueue<T> *queue = getDMACommandQueue();
+		if (queue)
+			return queue->push(command, getDMAGeneration());
+		executeDMACommand(command, scratch);
+		return true;
+	}
+
+	// Small persistent pool of threads for DMA work taken off the audio thread, which only polls.
+	class DMAWorkerPool {
+	public:
+		struct Task {
+			std::atomic<bool> pending;
+
+			Task() : pending(false) {}
+			virtual ~Task() = default;
+			virtual void run() = 0;
+
+			// Once this is false, everything the task wrote is visible to the caller.
+			bool isPending() const {
+				return pending.load(std::memory_order_acquire);
+			}
+		};
+
+		static constexpr std::size_t CAPACITY = 64;
+
+	private:
+		// Bounded multi-producer, multi-consumer ring (after Vyukov).
+		struct Slot {
+			std::atomic<std::size_t> sequence;
+			Task *task;
+		};
+		Slot slots[CAPACITY];
+		std::atomic<std::size_t> tail;
+		char tail_padding[64 - sizeof(std::atomic<std::size_t>)];
+		std::atomic<std::size_t> head;
+		char head_padding[64 - sizeof(std::atomic<std::size_t>)];
+		std::atomic<bool> stopping;
+		std::atomic<int> sleeping; // Workers blocked on wakeup, or about to be
+		std::atomic<int> waiting; // Threads blocked in wait(), or about to be
+		std::mutex mutex;
+		std::condition_variable wakeup;
+		std::condition_variable finished;
+		std::vector<std::thread> threads;
+
+		Task *pop() {
+			std::size_t pos = head.load(std::memory_order_relaxed);
+			for (;;) {
+				Slot &slot = slots[pos % CAPACITY];
+				std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)(pos + 1);
+				if (diff == 0) {
+					if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						Task *task = slot.task;
+						slot.sequence.store(pos + CAPACITY, std::memory_order_release);
+						return task;
+					}
+				} else if (diff < 0) {
+					return nullptr;
+				} else {
+					pos = head.load(std::memory_order_relaxed);
+				}
+			}
 		}
 
-		std::size_t size() const {
-			return count;
+		bool hasTask() const {
+			std::size_t pos = head.load(std::memory_order_relaxed);
+			return slots[pos % CAPACITY].sequence.load() == pos + 1;
 		}
-		
-		std::size_t width() const {
-			if (columns == 0)
-				return count;
-			else
-				return columns;
+
+		void run(Task *task) {
+			task->run();
+			task->pending.store(false); // Sequentially consistent with the count in wait()
+			if (waiting.load() > 0) {
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+				}
+				finished.notify_all();
+			}
 		}
 
-		std::size_t height() const {
-			if (columns == 0)
-				return 1;
-			else
-				return count / columns;
+		// Workers try a few more pops after each task, then sleep until woken.
+		void work() {
+			random::init();
+			while (!stopping.load(std::memory_order_relaxed)) {
+				Task *task = nullptr;
+				for (int spin=0; spin<64 && !task; ++spin)
+					task = pop();
+				if (task) {
+					run(task);
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(mutex);
+				sleeping.fetch_add(1); // Sequentially consistent with the publish in submit()
+				wakeup.wait(lock, [&]() {
+					return stopping.load(std::memory_order_relaxed) || hasTask();
+				});
+				sleeping.fetch_sub(1);
+			}
 		}
 
-		DMAHost<T> *getOwner() const {
-			return owner;
+		DMAWorkerPool() : tail(0), head(0), stopping(false), sleeping(0), waiting(0) {
+			for (std::size_t i=0; i<CAPACITY; ++i)
+				slots[i].sequence.store(i, std::memory_order_relaxed);
+			unsigned cores = std::thread::hardware_concurrency();
+			unsigned count = std::min(4u, std::max(1u, cores / 2));
+			for (unsigned i=0; i<count; ++i)
+				threads.emplace_back(&DMAWorkerPool::work, this);
 		}
 
-		accessor operator[](std::size_t index) {
-			accessor acc;
-			acc.channel = this;
-			acc.index = index;
-			return acc;
+	public:
+		~DMAWorkerPool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping.store(true);
+			}
+			wakeup.notify_all();
+			for (std::thread &thread : threads)
+				thread.join();
 		}
 
-		T operator[](std::size_t index) const {
-			return read(index);
+		DMAWorkerPool(const DMAWorkerPool &other) = delete;
+		DMAWorkerPool& operator=(const DMAWorkerPool &other) = delete;
+
+		// Started on first use and shared by every module.
+		static DMAWorkerPool &get() {
+			static DMAWorkerPool pool;
+			return pool;
 		}
-	};
 
-	template <typename T>
-	struct DMAHost {
-		virtual int getDMAChannelCount() const = 0;
-		virtual DMAChannel<T> *getDMAChannel(int num) = 0;
-		virtual const DMAChannel<T> *getDMAChannel(int num) const {
-			auto this_nonconst = const_cast<DMAHost*>(this);
-			return const_cast<const DMAChannel<T>*>(this_nonconst->getDMAChannel(num));
+		std::size_t getThreadCount() const {
+			return threads.size();
 		}
-		virtual bool readyForDMA() const {
-			return true;
+
+		// Runs the task on the calling thread if the queue is full; only locks to wake a sleeping worker.
+		void submit(Task *task) {
+			task->pending.store(true, std::memory_order_relaxed);
+			std::size_t pos = tail.load(std::memory_order_relaxed);
+			for (;;) {
+				Slot &slot = slots[pos % CAPACITY];
+				std::size_t seq = slot.sequence.load(std::memory_order_acquire);
+				std::ptrdiff_t diff = (std::ptrdiff_t)seq - (std::ptrdiff_t)pos;
+				if (diff == 0) {
+					if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						slot.task = task;
+						slot.sequence.store(pos + 1);
+						if (sleeping.load() > 0) {
+							{
+								std::lock_guard<std::mutex> lock(mutex);
+							}
+							wakeup.notify_one();
+						}
+						return;
+					}
+				} else if (diff < 0) {
+					return run(task);
+				} else {
+					pos = tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Helps with queued tasks, then sleeps until none of the given ones is pending.
+		void wait(Task *const *tasks, int n) {
+			auto done = [&]() {
+				for (int i=0; i<n; ++i) {
+					if (tasks[i]->pending.load()) // Sequentially consistent, as in run()
+						return false;
+				}
+				return true;
+			};
+			while (!done()) {
+				if (Task *task = pop()) {
+					run(task);
+					continue;
+				}
+				std::unique_lock<std::mutex> lock(mutex);
+				waiting.fetch_add(1);
+				finished.wait(lock, done);
+				waiting.fetch_sub(1);
+			}
 		}
-		virtual void onDMAWrite(const DMAWriteEvent<T> &e) {}
 	};
 
 	template <typename T>
 	class DMAClient : public DMAHost<T> {
+		static constexpr int MAX_CACHED_CHANNELS = 32;
+
 		DMAHost<T> *host = nullptr;
+		mutable unsigned cache_generation = ~0u;
+		mutable int cached_count = 0;
+		mutable DMAChannel<T> *cached_channels[MAX_CACHED_CHANNELS];
+		mutable DMAChannelInfo cached_info[MAX_CACHED_CHANNELS];
+		mutable unsigned cached_info_version[MAX_CACHED_CHANNELS];
+		mutable DMAChannelInfo uncached_info;
+
+		// Cached until this client's chain next changes.
+		void refreshDMAChannels() const {
+			unsigned generation = this->getDMAGeneration();
+			if (generation == cache_generation)
+				return;
+			cache_generation = generation;
+			if (host) {
+				cached_count = host->getDMAChannelCount();
+				for (int i=0; i<cached_count && i<MAX_CACHED_CHANNELS; ++i) {
+					cached_channels[i] = host->getDMAChannel(i);
+					cached_info_version[i] = cached_channels[i] ? cached_channels[i]->getDMAInfoVersion() : 0;
+					cached_info[i] = cached_channels[i] ? cached_channels[i]->getDMAInfo() : DMAChannelInfo();
+				}
+			} else {
+				cached_count = 0;
+			}
+		}
 
 	public:
 		struct DMAHostChangeEvent {
@@ -151,40 +2148,98 @@ namespace sparkette {
 
 	public:
 		virtual void onDMAHostChange(const DMAHostChangeEvent &e) {}
+		// Called by invalidateDMAChain() after this client's chain changes, hosts first.
+		virtual void onDMAChainChange() {}
 
 		DMAHost<T> *getDMAHost() const {
 			return host;
 		}
 
 		int getDMAChannelCount() const override {
-			if (host)
-				return host->getDMAChannelCount();
-			else
-				return 0;
+			refreshDMAChannels();
+			return cached_count;
 		}
 
 		DMAChannel<T> *getDMAChannel(int num) override {
-			if (host)
-				return host->getDMAChannel(num);
-			else
+			refreshDMAChannels();
+			if (num < 0 || num >= cached_count)
 				return nullptr;
+			else if (num < MAX_CACHED_CHANNELS)
+				return cached_channels[num];
+			else
+				return host->getDMAChannel(num);
 		}
 
 		const DMAChannel<T> *getDMAChannel(int num) const override {
-			if (host)
-				return host->getDMAChannel(num);
-			else
-				return nullptr;
+			return const_cast<DMAClient*>(this)->getDMAChannel(num);
+		}
+
+		// The channel's descriptor, cached with it; empty for a missing channel.
+		const DMAChannelInfo &getDMAChannelInfo(int num) const {
+			refreshDMAChannels();
+			if (num >= 0 && num < cached_count && num < MAX_CACHED_CHANNELS) {
+				const DMAChannel<T> *channel = cached_channels[num];
+				if (channel && channel->getDMAInfoVersion() != cached_info_version[num]) {
+					cached_info_version[num] = channel->getDMAInfoVersion();
+					cached_info[num] = channel->getDMAInfo();
+				}
+				return cached_info[num];
+			}
+			const DMAChannel<T> *channel = (num >= 0 && num < cached_count) ? host->getDMAChannel(num) : nullptr;
+			uncached_info = channel ? channel->getDMAInfo() : DMAChannelInfo();
+			return uncached_info;
 		}
 
 		bool readyForDMA() const override {
-			if (host)
-				return host->readyForDMA();
-			else
-				return false;
+			return host ? host->readyForDMA() : false;
+		}
+
+		// Hands a command to its channel's owner; false if the owner's queue was full.
+		bool submitDMACommand(DMACommand<T> &command) {
+#ifdef SPARKETTE_DMA_PROFILE
+			command.issuer = &dma_client_profile;
+#endif
+			DMAHost<T> *owner = command.channel->getOwner();
+			if (owner)
+				return owner->acceptDMACommand(command, dma_scratch);
+			executeDMACommand(command, dma_scratch);
+			return true;
 		}
+
+#ifdef SPARKETTE_DMA_PROFILE
+		// Everything this client has submitted, wherever it ran.
+		DMAProfile dma_client_profile;
+#endif
+
+	protected:
+		DMAScratch<T> dma_scratch;
 	};
 
+	// Gives every host in module's chain a new generation, then tells its clients from the host end.
+	template <typename TFirst, typename... TRest>
+	void invalidateDMAChain(Module *module) {
+		Module *last = module;
+		while (DMAClient<TFirst> *client = dynamic_cast<DMAClient<TFirst>*>(last)) {
+			Module *next = last->rightExpander.module;
+			if (!next || !client->getDMAHost() || client->getDMAHost() != dynamic_cast<DMAHost<TFirst>*>(next))
+				break;
+			last = next;
+		}
+		for (Module *m = last; m; m = m->leftExpander.module) {
+			DMAHost<TFirst> *host = dynamic_cast<DMAHost<TFirst>*>(m);
+			if (!host)
+				break;
+			host->dma_generation.fetch_add(1, std::memory_order_acq_rel);
+			if (DMAClient<TFirst> *client = dynamic_cast<DMAClient<TFirst>*>(m))
+				client->onDMAChainChange();
+			DMAClient<TFirst> *left = dynamic_cast<DMAClient<TFirst>*>(m->leftExpander.module);
+			if (!left || left->getDMAHost() != host)
+				break;
+		}
+		if constexpr (sizeof...(TRest) > 0)
+			invalidateDMAChain<TRest...>(module);
+	}
+
 	template <typename TFirst, typename... TRest>
 	inline bool checkForDMAClient(Module *module) {
 		bool result = dynamic_cast<DMAClient<TFirst>*>(module) != nullptr;
@@ -209,9 +2264,11 @@ namespace sparkette {
 		int dmaClientLightID = -1;
 	
 	public:
+		// Either side: a client or a DMA Bridge that left may have commands queued here.
 		virtual void onExpanderChange(const ExpanderChangeEvent &e) override {
 			if (e.side == 0 && dmaClientLightID >= 0)
 				lights[dmaClientLightID].setBrightness(checkForDMAClient<T...>(leftExpander.module) ? 1.f : 0.f);
+			invalidateDMAChain<T...>(this);
 		}
 
 		int getDMAChannelCount() {
@@ -219,6 +2276,41 @@ namespace sparkette {
 		}
 	};
 
+	// A step of a host's DMAUndo in Rack's history.
+	template <typename T>
+	struct DMAUndoAction : history::ModuleAction {
+		std::unique_ptr<typename DMAUndo<T>::Step> step;
+
+		DMAUndoAction(Module *module, typename DMAUndo<T>::Step *step) : step(step) {
+			moduleId = module->id;
+			name = step->name;
+		}
+
+		void requestRestore(const typename DMAUndo<T>::Image &image) {
+			DMAHost<T> *host = dynamic_cast<DMAHost<T>*>(APP->engine->getModule(moduleId));
+			if (host && host->getDMAUndo())
+				host->getDMAUndo()->requestRestore(image);
+		}
+
+		void undo() override {
+			requestRestore(step->before);
+		}
+
+		void redo() override {
+			requestRestore(step->after);
+		}
+	};
+
+	// UI thread: moves a finished undo step of the module's memory into Rack's history.
+	template <typename T>
+	void pushDMAUndoSteps(Module *module) {
+		DMAHost<T> *host = dynamic_cast<DMAHost<T>*>(module);
+		if (!host || !host->getDMAUndo())
+			return;
+		if (typename DMAUndo<T>::Step *step = host->getDMAUndo()->takeStep())
+			APP->history->push(new DMAUndoAction<T>(module, step));
+	}
+
 	template <typename... T>
 	class DMAExpanderModule : public Module, public DMAClient<T>... {
 		template <typename TFirst, typename... TRest>
@@ -248,6 +2340,7 @@ namespace sparkette {
 	protected:
 		int dmaHostLightID = -1; //intended to be a GreenRedLight, so dmaHostLightID+1 will be used as well
 		int dmaClientLightID = -1;
+		int64_t dma_frame = 0;
 		
 		bool isHostReady() const {
 			bool _;
@@ -266,13 +2359,21 @@ namespace sparkette {
 			} else {
 				setDMAHosts<T...>(rightExpander.module);
 			}
+			invalidateDMAChain<T...>(this);
 		}
 
 		int getDMAChannelCount() /* NOT const, NOT override */ {
 			return checkMultiDMAChannels<DMAExpanderModule<T...>, DMAClient, T...>(this);
 		}
 
+		template <typename U>
+		bool submitDMACommand(DMACommand<U> &command) {
+			command.frame = dma_frame;
+			return DMAClient<U>::submitDMACommand(command);
+		}
+
 		virtual void process(const ProcessArgs &args) override {
+			dma_frame = args.frame;
 			if (dmaHostLightID >= 0) {
 				bool hostFound = false;
 				bool ready = checkHostReady<T...>(hostFound);
@@ -286,4 +2387,106 @@ namespace sparkette {
 			}
 		}
 	};
+
+#ifdef SPARKETTE_DMA_PROFILE
+	inline json_t *dmaProfileToJson(const DMAProfile &profile) {
+		double seconds = profile.getSeconds();
+		json_t *root = json_object();
+		json_object_set_new(root, "seconds", json_real(seconds));
+		json_object_set_new(root, "reads", json_integer(profile.reads.load(std::memory_order_relaxed)));
+		json_object_set_new(root, "writes", json_integer(profile.writes.load(std::memory_order_relaxed)));
+		json_object_set_new(root, "events", json_integer(profile.events.load(std::memory_order_relaxed)));
+		json_object_set_new(root, "bytes", json_integer(profile.bytes.load(std::memory_order_relaxed)));
+		json_object_set_new(root, "nanoseconds", json_integer(profile.nanoseconds.load(std::memory_order_relaxed)));
+		return root;
+	}
+
+	inline std::string formatDMAProfile(const DMAProfile &profile) {
+		double seconds = profile.getSeconds();
+		return string::f("%.0f reads/s, %.0f writes/s, %.0f events/s, %.1f kB/s, %.2f%% CPU",
+			profile.reads.load(std::memory_order_relaxed) / seconds,
+			profile.writes.load(std::memory_order_relaxed) / seconds,
+			profile.events.load(std::memory_order_relaxed) / seconds,
+			profile.bytes.load(std::memory_order_relaxed) / seconds / 1000.0,
+			profile.nanoseconds.load(std::memory_order_relaxed) / seconds * 1e-7);
+	}
+
+	// Calls func(name, profile) for what module issues as a client and for each channel it owns.
+	template <typename T, typename F>
+	void forEachDMAProfileOf(Module *module, const char *type, F func) {
+		DMAHost<T> *host = dynamic_cast<DMAHost<T>*>(module);
+		if (!host)
+			return;
+		if (DMAClient<T> *client = dynamic_cast<DMAClient<T>*>(module))
+			func(string::f("%s client", type), client->dma_client_profile);
+		bool owner = false;
+		for (int i=0; i<host->getDMAChannelCount(); ++i) {
+			DMAChannel<T> *channel = host->getDMAChannel(i);
+			if (channel && channel->getOwner() == host) {
+				func(string::f("%s channel %d", type, i), channel->getDMAProfile());
+				owner = true;
+			}
+		}
+		if (owner)
+			func(string::f("%s host", type), host->dma_host_profile);
+	}
+
+	struct DMAProfileJsonWriter {
+		json_t *root;
+		void operator()(const std::string &name, DMAProfile &profile) const {
+			json_object_set_new(root, name.c_str(), dmaProfileToJson(profile));
+		}
+	};
+
+	struct DMAProfileMenuWriter {
+		Menu *menu;
+		void operator()(const std::string &name, DMAProfile &profile) const {
+			menu->addChild(createMenuLabel(name + ": " + formatDMAProfile(profile)));
+		}
+	};
+
+	struct DMAProfileResetter {
+		void operator()(const std::string &, DMAProfile &profile) const {
+			profile.reset();
+		}
+	};
+
+	template <typename F>
+	void forEachDMAProfile(Module *module, F func) {
+		forEachDMAProfileOf<float>(module, "float", func);
+		forEachDMAProfileOf<bool>(module, "bool", func);
+	}
+
+	inline json_t *dmaProfileToJson(Module *module) {
+		json_t *root = json_object();
+		forEachDMAProfile(module, DMAProfileJsonWriter{root});
+		return root;
+	}
+#endif
+
+	// Profiler entries for a DMA module's context menu; adds nothing unless built with DMA_PROFILE=1.
+	inline void appendDMAProfileMenu(Menu *menu, Module *module) {
+#ifdef SPARKETTE_DMA_PROFILE
+		menu->addChild(new MenuSeparator);
+		menu->addChild(createBoolMenuItem("DMA profiling", "", []() {
+			return dmaProfiling().load();
+		}, [=](bool enable) {
+			forEachDMAProfile(module, DMAProfileResetter());
+			dmaProfiling().store(enable);
+		}));
+		menu->addChild(createSubmenuItem("DMA profile", "", [=](Menu *menu) {
+			forEachDMAProfile(module, DMAProfileMenuWriter{menu});
+			menu->addChild(new MenuSeparator);
+			menu->addChild(createMenuItem("Reset counters", "", [=]() {
+				forEachDMAProfile(module, DMAProfileResetter());
+			}));
+			menu->addChild(createMenuItem("Dump to JSON", "", [=]() {
+				json_t *root = dmaProfileToJson(module);
+				std::string path = asset::user(string::f("SparketteDMAProfile-%lld.json", (long long)module->id));
+				json_dump_file(root, path.c_str(), JSON_INDENT(2));
+				json_decref(root);
+			}));
+		}));
+#endif
+	}
 }
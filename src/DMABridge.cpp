@@ -0,0 +1,349 @@
+#include "plugin.hpp"
+#include "DMA.hpp"
+#include "Widgets.hpp"
+
+using namespace sparkette;
+
+// Converting copies follow the Accessor's conventions: gates above 0.5V are set, and
+// set cells read as 10V.
+static void convertCells(const float *in, bool *out, std::size_t n) {
+	for (std::size_t i=0; i<n; ++i)
+		out[i] = in[i] > 0.5f;
+}
+
+static void convertCells(const bool *in, float *out, std::size_t n) {
+	for (std::size_t i=0; i<n; ++i)
+		out[i] = in[i] ? 10.f : 0.f;
+}
+
+// Sits between two hosts and copies a rectangle from a channel of one into a channel of
+// the other. The host on the right is this module's host as for any other expander; the
+// one on the left is reached through leftExpander. Each copy is a rectangular READ_BLOCK
+// on the source followed by a rectangular WRITE_BLOCK on the destination, both queued
+// for their hosts, so the cells move a row at a time rather than one by one. Large
+// rectangles go over in bands of whole rows that fit buffers sized up front, so nothing
+// is allocated on the audio thread however much is copied.
+struct DMABridge : DMAExpanderModule<float, bool> {
+	static constexpr int BAND_CELLS = 16384;
+
+	enum ParamId {
+		DIRECTION_PARAM,
+		SRC_CHANNEL_PARAM,
+		DEST_CHANNEL_PARAM,
+		SRC_X_PARAM,
+		SRC_Y_PARAM,
+		DEST_X_PARAM,
+		DEST_Y_PARAM,
+		WIDTH_PARAM,
+		HEIGHT_PARAM,
+		RATE_PARAM,
+		COPY_PARAM,
+		PARAMS_LEN
+	};
+	enum InputId {
+		COPY_INPUT,
+		INPUTS_LEN
+	};
+	enum OutputId {
+		DONE_OUTPUT,
+		OUTPUTS_LEN
+	};
+	enum LightId {
+		DMA_LEFT_LIGHT_G,
+		DMA_LEFT_LIGHT_R,
+		DMA_HOST_LIGHT_G,
+		DMA_HOST_LIGHT_R,
+		COPY_LIGHT,
+		LIGHTS_LEN
+	};
+
+	enum Phase { IDLE, READ, WRITE };
+
+	// A channel of one side, as whichever element type it has. Float wins if it has both.
+	struct Endpoint {
+		DMAChannel<float> *dmaF = nullptr;
+		DMAChannel<bool> *dmaB = nullptr;
+
+		DMAChannelInfo getInfo() const {
+			return dmaF ? dmaF->getDMAInfo() : dmaB ? dmaB->getDMAInfo() : DMAChannelInfo();
+		}
+	};
+
+	DMAHost<float> *leftF = nullptr;
+	DMAHost<bool> *leftB = nullptr;
+	dsp::SchmittTrigger copy_trigger;
+	dsp::SchmittTrigger copy_button;
+	dsp::PulseGenerator done_pulse;
+	float rate_phase = 0.f;
+	bool copy_pending = false;
+
+	Phase phase = IDLE;
+	Endpoint src, dest;
+	int src_address = 0, dest_address = 0;
+	int src_stride = 0, dest_stride = 0;
+	int copy_width = 0, copy_height = 0;
+	int band_row = 0, band_rows = 0; // First row of the band in flight, and rows per band
+	bool checkpoint = false;
+	unsigned generation = 0; // getCopyGeneration() when the copy started
+	unsigned left_changes = 0;
+	int64_t issued = -2;
+	DMABuffer<float> cellsF, convertedF;
+	DMABuffer<bool> cellsB, convertedB;
+
+	DMABridge() {
+		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		configSwitch(DIRECTION_PARAM, 0.f, 1.f, 0.f, "Direction", {"Left to right", "Right to left"});
+		configParam(SRC_CHANNEL_PARAM, 0.f, 15.f, 0.f, "Source channel");
+		configParam(DEST_CHANNEL_PARAM, 0.f, 15.f, 0.f, "Destination channel");
+		configParam(SRC_X_PARAM, 0.f, 1023.f, 0.f, "Source X");
+		configParam(SRC_Y_PARAM, 0.f, 1023.f, 0.f, "Source Y");
+		configParam(DEST_X_PARAM, 0.f, 1023.f, 0.f, "Destination X");
+		configParam(DEST_Y_PARAM, 0.f, 1023.f, 0.f, "Destination Y");
+		configParam(WIDTH_PARAM, 0.f, 1024.f, 0.f, "Width (0: to the edge)");
+		configParam(HEIGHT_PARAM, 0.f, 1024.f, 0.f, "Height (0: to the edge)");
+		configParam(RATE_PARAM, 0.f, 1000.f, 0.f, "Continuous copy rate (0: off)", " Hz");
+		configButton(COPY_PARAM, "Copy");
+		for (int i=SRC_CHANNEL_PARAM; i<=HEIGHT_PARAM; ++i)
+			paramQuantities[i]->snapEnabled = true;
+		configInput(COPY_INPUT, "Copy trigger");
+		configOutput(DONE_OUTPUT, "Copy done");
+
+		dmaHostLightID = DMA_HOST_LIGHT_G;
+		cellsF.get(BAND_CELLS);
+		cellsB.get(BAND_CELLS);
+		convertedF.get(BAND_CELLS);
+		convertedB.get(BAND_CELLS);
+	}
+
+	void onExpanderChange(const ExpanderChangeEvent &e) override {
+		DMAExpanderModule<float, bool>::onExpanderChange(e);
+		if (e.side == 0) {
+			leftF = getLeftHost<float>();
+			leftB = getLeftHost<bool>();
+			++left_changes;
+		}
+	}
+
+	// Changes along with the chain on either side, as either host may drop a band then.
+	unsigned getCopyGeneration() const {
+		return left_changes + DMAClient<float>::getDMAGeneration() + DMAClient<bool>::getDMAGeneration()
+			+ (leftF ? leftF->getDMAGeneration() : 0) + (leftB ? leftB->getDMAGeneration() : 0);
+	}
+
+	// A client on the left would only lead back here through its own host.
+	template <typename T>
+	DMAHost<T> *getLeftHost() {
+		DMAClient<T> *client = dynamic_cast<DMAClient<T>*>(leftExpander.module);
+		if (client && client->getDMAHost() == static_cast<DMAHost<T>*>(this))
+			return nullptr;
+		return dynamic_cast<DMAHost<T>*>(leftExpander.module);
+	}
+
+	template <typename T>
+	static DMAChannel<T> *getChannel(DMAHost<T> *host, int num) {
+		if (!host || !host->readyForDMA() || num >= host->getDMAChannelCount())
+			return nullptr;
+		return host->getDMAChannel(num);
+	}
+
+	Endpoint getEndpoint(bool left, int num) {
+		Endpoint endpoint;
+		if (left) {
+			endpoint.dmaF = getChannel(leftF, num);
+			endpoint.dmaB = getChannel(leftB, num);
+		} else {
+			endpoint.dmaF = getChannel<float>(this, num);
+			endpoint.dmaB = getChannel<bool>(this, num);
+		}
+		return endpoint;
+	}
+
+	// Works out the rectangle from the parameters and reads its first band out of the
+	// source. Returns false if the source's host couldn't take the read yet.
+	bool startCopy(bool checkpoint) {
+		bool left_to_right = params[DIRECTION_PARAM].getValue() < 0.5f;
+		src = getEndpoint(left_to_right, (int)params[SRC_CHANNEL_PARAM].getValue());
+		dest = getEndpoint(!left_to_right, (int)params[DEST_CHANNEL_PARAM].getValue());
+		int sx = (int)params[SRC_X_PARAM].getValue(), sy = (int)params[SRC_Y_PARAM].getValue();
+		int dx = (int)params[DEST_X_PARAM].getValue(), dy = (int)params[DEST_Y_PARAM].getValue();
+		DMAChannelInfo src_info = src.getInfo(), dest_info = dest.getInfo();
+		if (!dest_info.writable)
+			return true;
+		int sw = (int)src_info.width, sh = (int)src_info.height;
+		int dw = (int)dest_info.width, dh = (int)dest_info.height;
+		int w = (int)params[WIDTH_PARAM].getValue(), h = (int)params[HEIGHT_PARAM].getValue();
+		if (w == 0)
+			w = sw;
+		if (h == 0)
+			h = sh;
+		copy_width = std::min(std::min(w, (int)BAND_CELLS), std::min(sw - sx, dw - dx));
+		copy_height = std::min(h, std::min(sh - sy, dh - dy));
+		if (copy_width <= 0 || copy_height <= 0)
+			return true;
+		src_address = sw * sy + sx;
+		dest_address = dw * dy + dx;
+		src_stride = sw;
+		dest_stride = dw;
+		band_rows = BAND_CELLS / copy_width;
+		this->checkpoint = checkpoint;
+		generation = getCopyGeneration();
+		return readBand(0);
+	}
+
+	int bandHeight() const {
+		return std::min(band_rows, copy_height - band_row);
+	}
+
+	// Reads the band starting at row into the buffers. Returns false if the source's host
+	// couldn't take the read yet, leaving the copy where it was.
+	bool readBand(int row) {
+		int rows = std::min(band_rows, copy_height - row);
+		int address = src_address + src_stride * row;
+		bool submitted;
+		if (src.dmaF)
+			submitted = submitBlock(DMACommand<float>::READ_BLOCK, src.dmaF, address, rows, cellsF.data());
+		else
+			submitted = submitBlock(DMACommand<bool>::READ_BLOCK, src.dmaB, address, rows, cellsB.data());
+		if (submitted) {
+			band_row = row;
+			phase = READ;
+		}
+		return submitted;
+	}
+
+	// Writes the band that was read into the destination, converting it first if the types
+	// differ. If the destination's host can't take it yet, this is tried again next frame.
+	void writeBand() {
+		int rows = bandHeight();
+		std::size_t n = copy_width * rows;
+		int address = dest_address + dest_stride * band_row;
+		bool submitted;
+		if (dest.dmaF) {
+			const float *values = cellsF.data();
+			if (!src.dmaF) {
+				convertCells(cellsB.data(), convertedF.get(n), n);
+				values = convertedF.data();
+			}
+			submitted = submitBlock(DMACommand<float>::WRITE_BLOCK, dest.dmaF, address, rows, values);
+		} else {
+			const bool *values = cellsB.data();
+			if (src.dmaF) {
+				convertCells(cellsF.data(), convertedB.get(n), n);
+				values = convertedB.data();
+			}
+			submitted = submitBlock(DMACommand<bool>::WRITE_BLOCK, dest.dmaB, address, rows, values);
+		}
+		if (submitted)
+			phase = WRITE;
+	}
+
+	// Every band of a copy asked for on its own is a checkpoint. The host merges them into
+	// one undo step unless the UI happens to take the step in between.
+	template <typename T>
+	bool submitBlock(typename DMACommand<T>::Type type, DMAChannel<T> *dma, int address, int rows, const T *values) {
+		DMACommand<T> command;
+		command.type = type;
+		command.channel = dma;
+		command.addresses[0] = address;
+		command.width = copy_width;
+		command.count = copy_width * rows;
+		if (type == DMACommand<T>::READ_BLOCK)
+			command.target = const_cast<T*>(values);
+		else
+			command.source = values;
+		command.checkpoint = checkpoint && type == DMACommand<T>::WRITE_BLOCK;
+		if (!submitDMACommand(command))
+			return false;
+		issued = dma_frame;
+		return true;
+	}
+
+	void process(const ProcessArgs& args) override {
+		DMAExpanderModule<float, bool>::process(args);
+
+		bool left_found = leftF || leftB;
+		bool left_ready = (leftF && leftF->readyForDMA()) || (leftB && leftB->readyForDMA());
+		lights[DMA_LEFT_LIGHT_G].setBrightnessSmooth(left_ready ? 1.f : 0.f, args.sampleTime);
+		lights[DMA_LEFT_LIGHT_R].setBrightnessSmooth((left_found && !left_ready) ? 1.f : 0.f, args.sampleTime);
+
+		bool triggered = copy_trigger.process(inputs[COPY_INPUT].getVoltage());
+		bool pressed = copy_button.process(params[COPY_PARAM].getValue());
+		if (triggered || pressed)
+			copy_pending = true;
+		bool continuous = false;
+		float rate = params[RATE_PARAM].getValue();
+		if (rate > 0.f) {
+			rate_phase += rate * args.sampleTime;
+			if (rate_phase >= 1.f) {
+				rate_phase -= std::floor(rate_phase);
+				continuous = true;
+			}
+		} else {
+			rate_phase = 0.f;
+		}
+
+		// Both buffers are the bridge's until the host has finished with the last command
+		if (phase != IDLE && isDMACommandDone(issued, dma_frame)) {
+			if (getCopyGeneration() != generation) {
+				phase = IDLE; // Rewired mid-copy; the channels may be gone
+			} else if (phase == READ) {
+				writeBand();
+			} else if (band_row + bandHeight() < copy_height) {
+				readBand(band_row + bandHeight());
+			} else {
+				phase = IDLE;
+				done_pulse.trigger();
+			}
+		}
+		if (phase == IDLE && (copy_pending || continuous)) {
+			// Only copies asked for one at a time go into the undo history
+			if (startCopy(copy_pending))
+				copy_pending = false;
+		}
+
+		lights[COPY_LIGHT].setBrightnessSmooth(phase != IDLE ? 1.f : 0.f, args.sampleTime);
+		outputs[DONE_OUTPUT].setVoltage(done_pulse.process(args.sampleTime) ? 10.f : 0.f);
+	}
+};
+
+
+struct DMABridgeWidget : ModuleWidget {
+	DMABridgeWidget(DMABridge* module) {
+		setModule(module);
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/DMABridge.svg")));
+
+		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, 0)));
+		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
+		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+
+		addParam(createParamCentered<CKSS>(mm2px(Vec(15.24, 17.0)), module, DMABridge::DIRECTION_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(8.89, 29.0)), module, DMABridge::SRC_CHANNEL_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(21.59, 29.0)), module, DMABridge::DEST_CHANNEL_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(8.89, 41.0)), module, DMABridge::SRC_X_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(21.59, 41.0)), module, DMABridge::DEST_X_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(8.89, 51.0)), module, DMABridge::SRC_Y_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(21.59, 51.0)), module, DMABridge::DEST_Y_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(8.89, 63.0)), module, DMABridge::WIDTH_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(21.59, 63.0)), module, DMABridge::HEIGHT_PARAM));
+		addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(15.24, 77.0)), module, DMABridge::RATE_PARAM));
+		addParam(createParamCentered<VCVButton>(mm2px(Vec(21.59, 92.0)), module, DMABridge::COPY_PARAM));
+
+		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(8.89, 92.0)), module, DMABridge::COPY_INPUT));
+
+		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(15.24, 104.0)), module, DMABridge::DONE_OUTPUT));
+
+		addChild(createLightCentered<SmallLight<GreenRedLight>>(Vec(8.0, 8.0), module, DMABridge::DMA_LEFT_LIGHT_G));
+		addChild(createLightCentered<SmallLight<GreenRedLight>>(Vec(box.size.x - 8.0, 8.0), module, DMABridge::DMA_HOST_LIGHT_G));
+		addChild(createLightCentered<MediumLight<YellowLight>>(mm2px(Vec(21.59, 98.0)), module, DMABridge::COPY_LIGHT));
+	}
+
+	void appendContextMenu(Menu* menu) override {
+		auto module = dynamic_cast<DMABridge*>(this->module);
+		menu->addChild(new MenuEntry);
+		appendDMAProfileMenu(menu, module);
+	}
+};
+
+
+Model* modelDMABridge = createModel<DMABridge, DMABridgeWidget>("DMABridge");
@@ -4,7 +4,8 @@
 #include "Lights.hpp"
 #include <utility>
 #include <functional>
-#include <vector>
+#include <algorithm>
+#include <climits>
 
 using namespace sparkette;
 
@@ -39,6 +40,7 @@ struct DMAFX : DMAExpanderModule<float, bool> {
 		INPUTS_LEN
 	};
 	enum OutputId {
+		BUSY_OUTPUT,
 		OUTPUTS_LEN
 	};
 	enum LightId {
@@ -61,8 +63,6 @@ struct DMAFX : DMAExpanderModule<float, bool> {
 	dsp::SchmittTrigger tr_random[PORT_MAX_CHANNELS];
 	dsp::SchmittTrigger tr_random_btn;
 
-	std::vector<float> scratch;
-
 	void onTrigger(int input, dsp::SchmittTrigger triggers[], int dma_nchan, const std::function<void(int)> &func, bool force = false) {
 		int nchan = inputs[input].getChannels();
 		if (nchan > 1) {
@@ -108,49 +108,21 @@ struct DMAFX : DMAExpanderModule<float, bool> {
 		configInput(FLIP_H_INPUT, "Horizontal flip");
 		configInput(INVERT_INPUT, "Invert");
 		configInput(RANDOMIZE_INPUT, "Randomize");
+		configOutput(BUSY_OUTPUT, "Busy");
 
 		dmaClientLightID = DMA_CLIENT_LIGHT;
 		dmaHostLightID = DMA_HOST_LIGHT_G;
-	}
 
-	template <typename T>
-	void scroll(DMAChannel<T> &dma, int dx, int dy) {
-		bool wrap = params[SCROLL_WRAP_PARAM].getValue() > 0.5f;
-		int cols = dma.width();
-		int rows = dma.height();
-		scratch.resize(std::max(cols, rows));
-
-		// Handle horizontal scrolling
-		if (dx != 0) {
-			int dx_mod = (dx % cols + cols) % cols; // Ensure dx_mod is positive
-			for (int y = 0; y < rows; ++y) {
-				for (int x = 0; x < cols; ++x)
-					scratch[x] = dma.read(x, y);
-				for (int x = 0; x < cols; ++x) {
-					int targetX = (x + dx_mod) % cols;
-					if (wrap || (x + dx < cols && x + dx >= 0))
-						dma.write(targetX, y, scratch[x]);
-					else
-						dma.write(targetX, y, 0); // Zero out pixels that scroll beyond the edge
-				}
-			}
+		for (int ch=0; ch<PORT_MAX_CHANNELS; ++ch) {
+			slices[2 * ch] = &jobsF[ch].slice;
+			slices[2 * ch + 1] = &jobsB[ch].slice;
 		}
+	}
 
-		// Handle vertical scrolling
-		if (dy != 0) {
-			int dy_mod = (dy % rows + rows) % rows; // Ensure dy_mod is positive
-			for (int x = 0; x < cols; ++x) {
-				for (int y = 0; y < rows; ++y)
-					scratch[y] = dma.read(x, y);
-				for (int y = 0; y < rows; ++y) {
-					int targetY = (y + dy_mod) % rows;
-					if (wrap || (y + dy < rows && y + dy >= 0))
-						dma.write(x, targetY, scratch[y]);
-					else
-						dma.write(x, targetY, 0); // Zero out pixels that scroll beyond the edge
-				}
-			}
-		}
+	// Slices still running on the pool write into the jobs' buffers
+	~DMAFX() {
+		if (std::any_of(slices, slices + 2 * PORT_MAX_CHANNELS, [](DMAWorkerPool::Task *slice) { return slice->isPending(); }))
+			DMAWorkerPool::get().wait(slices, 2 * PORT_MAX_CHANNELS);
 	}
 
 	void getScrollOffsets(int input, int &dx, int &dy) {
@@ -178,76 +150,211 @@ struct DMAFX : DMAExpanderModule<float, bool> {
 		}
 	}
 
+	// Immediate operations are queued for the host to apply with the rest of its batch.
+	// Returns false if the host didn't take it: its queue was full, or the channel spans
+	// more than one host's memory.
 	template <typename T>
-	void flipV(DMAChannel<T> &dma) {
-		int cols = dma.width();
-		int rows = dma.height();
-		for (int x=0; x<cols; ++x) {
-			for (int y=0; y<rows/2; ++y) {
-				T temp = dma.read(x, y);
-				dma.write(x, y, dma.read(x, rows-1-y));
-				dma.write(x, rows-1-y, temp);
-			}
-		}
+	bool perform(DMAChannel<T> &dma, const DMATransform &op) {
+		DMACommand<T> command;
+		command.type = DMACommand<T>::TRANSFORM;
+		command.channel = &dma;
+		command.transform = op;
+		command.checkpoint = true;
+		return submitDMACommand(command);
 	}
 
+	// Time-sliced execution: with a work budget set, operations are spread over as
+	// many samples as needed. The host copies the channel into src, the result is
+	// computed into dest a cell at a time, and the host writes it back in a single
+	// block, so readers only ever see the memory before or after an operation.
+	// Both copies are queued commands, and a job leaves its buffers alone until the
+	// host is done with them. Writes made to the channel by others while an operation
+	// runs are overwritten.
+	//
+	// In parallel mode every operation becomes a job, each channel gets the whole
+	// budget, and the compute step of every job runs on the shared worker pool.
+	// process() never waits for a slice; each is committed on the first sample that
+	// finds it done.
+	static constexpr int MAX_QUEUED_OPS = 8;
+	int work_budget = 0; // Cells per sample; 0 runs everything immediately
+	bool parallel = false;
+	int next_job = 0;
+
+	// A range of cells of one operation, with its own copy of everything it reads so
+	// the job can take new operations while it runs.
 	template <typename T>
-	void flipH(DMAChannel<T> &dma) {
-		int cols = dma.width();
-		int rows = dma.height();
-		for (int y=0; y<rows; ++y) {
-			for (int x=0; x<cols/2; ++x) {
-				T temp = dma.read(x, y);
-				dma.write(x, y, dma.read(cols-1-x, y));
-				dma.write(cols-1-x, y, temp);
-			}
+	struct Slice : DMAWorkerPool::Task {
+		DMATransform op;
+		const T *src = nullptr;
+		T *dest = nullptr;
+		int cols = 0;
+		int rows = 0;
+		std::size_t begin = 0;
+		std::size_t end = 0;
+
+		void run() override {
+			compute(*this);
 		}
-	}
+	};
 
 	template <typename T>
-	void rotateCW(DMAChannel<T> &dma) {
-		int n = dma.width(); // Assuming the matrix is square
-
-		// Transpose the matrix
-		for (int y = 0; y < n; ++y) {
-			for (int x = y + 1; x < n; ++x) {
-				T temp = dma.read(x, y);
-				dma.write(x, y, dma.read(y, x));
-				dma.write(y, x, temp);
-			}
+	struct Job {
+		enum Phase { READ, COMPUTE, COMMIT };
+		DMAChannel<T> *dma = nullptr;
+		DMATransform ops[MAX_QUEUED_OPS];
+		int queued = 0;
+		Phase phase = READ;
+		std::size_t progress = 0;
+		std::size_t cols = 0;
+		std::size_t rows = 0;
+		DMABuffer<T> src, dest;
+		int64_t issued = -2; // Frame of the last command using src or dest
+		unsigned generation = 0; // Our chain's generation when src was read
+		Slice<T> slice;
+
+		void start(unsigned generation) {
+			phase = (ops[0].type == DMATransform::RANDOMIZE) ? COMPUTE : READ;
+			this->generation = generation;
+			progress = 0;
+			cols = dma->width();
+			rows = dma->height();
 		}
+	};
+	Job<float> jobsF[PORT_MAX_CHANNELS];
+	Job<bool> jobsB[PORT_MAX_CHANNELS];
+	DMAWorkerPool::Task *slices[2 * PORT_MAX_CHANNELS];
 
-		// Flip horizontally
-		for (int y = 0; y < n; ++y) {
-			for (int x = 0; x < n / 2; ++x) {
-				T temp = dma.read(x, y);
-				dma.write(x, y, dma.read(n - 1 - x, y));
-				dma.write(n - 1 - x, y, temp);
-			}
+	template <typename T>
+	void apply(Job<T> &job, DMAChannel<T> &dma, const DMATransform &op) {
+		if (job.dma != &dma)
+			job.queued = 0;
+		// An operation the host refuses runs as a job instead, which retries until queued
+		if (work_budget == 0 && !parallel && job.queued == 0 && perform(dma, op))
+			return;
+		if (job.queued == MAX_QUEUED_OPS)
+			return;
+		job.ops[job.queued++] = op;
+		if (job.queued == 1) {
+			job.dma = &dma;
+			job.start(DMAClient<T>::getDMAGeneration());
 		}
 	}
 
 	template <typename T>
-	void rotateCCW(DMAChannel<T> &dma) {
-		int n = dma.width(); // Assuming the matrix is square
-
-		// Transpose the matrix
-		for (int y = 0; y < n; ++y) {
-			for (int x = y + 1; x < n; ++x) {
-				T temp = dma.read(x, y);
-				dma.write(x, y, dma.read(y, x));
-				dma.write(y, x, temp);
-			}
+	static void compute(const Slice<T> &slice) {
+		const DMATransform &op = slice.op;
+		const T *src = slice.src;
+		T *dest = slice.dest;
+		int cols = slice.cols, rows = slice.rows;
+		std::size_t begin = slice.begin, end = slice.end;
+		switch (op.type) {
+			case DMATransform::SCROLL:
+				for (std::size_t i=begin; i<end; ++i) {
+					int x = (int)i % cols - op.dx;
+					int y = (int)i / cols - op.dy;
+					if (x < 0 || x >= cols || y < 0 || y >= rows) {
+						if (!op.wrap) {
+							dest[i] = T(0);
+							continue;
+						}
+						x = (x % cols + cols) % cols;
+						y = (y % rows + rows) % rows;
+					}
+					dest[i] = src[cols * y + x];
+				}
+				break;
+			case DMATransform::FLIP_V:
+				for (std::size_t i=begin; i<end; ++i)
+					dest[i] = src[cols * (rows - 1 - (int)i / cols) + (int)i % cols];
+				break;
+			case DMATransform::FLIP_H:
+				for (std::size_t i=begin; i<end; ++i)
+					dest[i] = src[cols * ((int)i / cols) + (cols - 1 - (int)i % cols)];
+				break;
+			case DMATransform::ROTATE_CW:
+				for (std::size_t i=begin; i<end; ++i)
+					dest[i] = src[cols * (cols - 1 - (int)i % cols) + (int)i / cols];
+				break;
+			case DMATransform::ROTATE_CCW:
+				for (std::size_t i=begin; i<end; ++i)
+					dest[i] = src[cols * ((int)i % cols) + (cols - 1 - (int)i / cols)];
+				break;
+			case DMATransform::INVERT:
+				for (std::size_t i=begin; i<end; ++i)
+					dest[i] = dmaInvertValue(src[i], op.offset);
+				break;
+			case DMATransform::RANDOMIZE:
+				for (std::size_t i=begin; i<end; ++i)
+					dest[i] = dmaRandomValue(dest, op.offset, op.scale);
+				break;
 		}
+	}
 
-		// Flip vertically
-		for (int x = 0; x < n; ++x) {
-			for (int y = 0; y < n / 2; ++y) {
-				T temp = dma.read(x, y);
-				dma.write(x, y, dma.read(x, n - 1 - y));
-				dma.write(x, n - 1 - y, temp);
+	// Advances job by up to budget cells of work and returns the amount done.
+	template <typename T>
+	int runJob(Job<T> &job, DMAChannel<T> *dma, int budget) {
+		if (job.queued == 0)
+			return 0;
+		if (job.dma != dma || dma->width() != job.cols || dma->height() != job.rows) {
+			job.queued = 0; // The channel went away or changed shape
+			return 0;
+		}
+		if (job.slice.isPending() || !isDMACommandDone(job.issued, dma_frame))
+			return 0;
+		unsigned generation = DMAClient<T>::getDMAGeneration();
+		if (job.generation != generation)
+			job.start(generation); // The host dropped the read along with the rest of its stale commands
+		std::size_t count = job.cols * job.rows;
+		if (job.phase == Job<T>::READ) {
+			DMACommand<T> command;
+			command.type = DMACommand<T>::READ_BLOCK;
+			command.channel = dma;
+			command.addresses[0] = 0;
+			command.count = (int)count;
+			command.target = job.src.get(count);
+			if (!submitDMACommand(command))
+				return 0; // The host's queue is full; try again next sample
+			job.generation = generation;
+			job.issued = dma_frame;
+			job.phase = Job<T>::COMPUTE;
+			return 0;
+		}
+		int used = 0;
+		if (job.phase == Job<T>::COMPUTE) {
+			Slice<T> &slice = job.slice;
+			slice.op = job.ops[0];
+			slice.src = job.src.get(count);
+			slice.dest = job.dest.get(count);
+			slice.cols = (int)job.cols;
+			slice.rows = (int)job.rows;
+			slice.begin = job.progress;
+			slice.end = std::min(count, job.progress + (std::size_t)budget);
+			used = (int)(slice.end - slice.begin);
+			job.progress = slice.end;
+			if (job.progress == count)
+				job.phase = Job<T>::COMMIT;
+			if (parallel) {
+				DMAWorkerPool::get().submit(&slice);
+				return used;
 			}
+			slice.run();
+		}
+		if (job.phase == Job<T>::COMMIT) {
+			DMACommand<T> command;
+			command.type = DMACommand<T>::WRITE_BLOCK;
+			command.channel = dma;
+			command.addresses[0] = 0;
+			command.count = (int)count;
+			command.source = job.dest.get(count);
+			command.checkpoint = true;
+			if (!submitDMACommand(command))
+				return used; // Committed next sample instead
+			job.issued = dma_frame;
+			std::copy(job.ops + 1, job.ops + job.queued, job.ops);
+			if (--job.queued > 0)
+				job.start(generation);
 		}
+		return used;
 	}
 
 	void process(const ProcessArgs& args) override {
@@ -279,88 +386,119 @@ struct DMAFX : DMAExpanderModule<float, bool> {
 			scroll_amount_nchan = 1;
 		}
 
+		bool wrap = params[SCROLL_WRAP_PARAM].getValue() > 0.5f;
 		for (int i=0; i<8; ++i) {
 			int dx, dy;
 			getScrollOffsets(SCROLL_NW_INPUT+i, dx, dy);
-			onTrigger(SCROLL_NW_INPUT+i, tr_scroll[i], dma_nchan, [this, dx, dy, scroll_amount_nchan, &scroll_amount, &dmaF, &dmaB](int ch) {
+			onTrigger(SCROLL_NW_INPUT+i, tr_scroll[i], dma_nchan, [this, dx, dy, wrap, scroll_amount_nchan, &scroll_amount, &dmaF, &dmaB](int ch) {
 				float amount = scroll_amount[ch % scroll_amount_nchan];
-				int DX = (int)((float)dx * amount);
-				int DY = (int)((float)dy * amount);
+				DMATransform op(DMATransform::SCROLL);
+				op.dx = (int)((float)dx * amount);
+				op.dy = (int)((float)dy * amount);
+				op.wrap = wrap;
 				if (dmaF[ch])
-					scroll(*dmaF[ch], DX, DY);
+					apply(jobsF[ch], *dmaF[ch], op);
 				else if (dmaB[ch])
-					scroll(*dmaB[ch], DX, DY);
+					apply(jobsB[ch], *dmaB[ch], op);
 			});
 		}
 
+		bool squareF[PORT_MAX_CHANNELS];
+		bool squareB[PORT_MAX_CHANNELS];
 		int rotate_lights = 0;
 		for (int i=0; i<dma_nchan; ++i) {
+			squareF[i] = dmaF[i] && DMAClient<float>::getDMAChannelInfo(i).isSquare();
+			squareB[i] = dmaB[i] && DMAClient<bool>::getDMAChannelInfo(i).isSquare();
 			if (dmaF[i])
-				rotate_lights |= (dmaF[i]->width() == dmaF[i]->height()) ? 1 : 2;
+				rotate_lights |= squareF[i] ? 1 : 2;
 			if (dmaB[i])
-				rotate_lights |= (dmaB[i]->width() == dmaB[i]->height()) ? 1 : 2;
+				rotate_lights |= squareB[i] ? 1 : 2;
 		}
 		lights[ROTATION_LIGHT_G].setBrightnessSmooth((rotate_lights & 1) ? 1.f : 0.f, args.sampleTime);
 		lights[ROTATION_LIGHT_R].setBrightnessSmooth((rotate_lights & 2) ? 1.f : 0.f, args.sampleTime);
 
 		onTrigger(ROTATE_CW_INPUT, tr_rotate_cw, dma_nchan, [&](int ch) {
-			if (dmaF[ch] && dmaF[ch]->width() == dmaF[ch]->height())
-				rotateCW(*dmaF[ch]);
-			if (dmaB[ch] && dmaB[ch]->width() == dmaB[ch]->height())
-				rotateCW(*dmaB[ch]);
+			if (squareF[ch])
+				apply(jobsF[ch], *dmaF[ch], DMATransform(DMATransform::ROTATE_CW));
+			if (squareB[ch])
+				apply(jobsB[ch], *dmaB[ch], DMATransform(DMATransform::ROTATE_CW));
 		});
 
 		onTrigger(ROTATE_CCW_INPUT, tr_rotate_ccw, dma_nchan, [&](int ch) {
-			if (dmaF[ch] && dmaF[ch]->width() == dmaF[ch]->height())
-				rotateCCW(*dmaF[ch]);
-			if (dmaB[ch] && dmaB[ch]->width() == dmaB[ch]->height())
-				rotateCCW(*dmaB[ch]);
+			if (squareF[ch])
+				apply(jobsF[ch], *dmaF[ch], DMATransform(DMATransform::ROTATE_CCW));
+			if (squareB[ch])
+				apply(jobsB[ch], *dmaB[ch], DMATransform(DMATransform::ROTATE_CCW));
 		});
 
 		onTrigger(FLIP_V_INPUT, tr_flip_v, dma_nchan, [&](int ch) {
 			if (dmaF[ch])
-				flipV(*dmaF[ch]);
+				apply(jobsF[ch], *dmaF[ch], DMATransform(DMATransform::FLIP_V));
 			else if (dmaB[ch])
-				flipV(*dmaB[ch]);
+				apply(jobsB[ch], *dmaB[ch], DMATransform(DMATransform::FLIP_V));
 		});
 
 		onTrigger(FLIP_H_INPUT, tr_flip_h, dma_nchan, [&](int ch) {
 			if (dmaF[ch])
-				flipH(*dmaF[ch]);
+				apply(jobsF[ch], *dmaF[ch], DMATransform(DMATransform::FLIP_H));
 			else if (dmaB[ch])
-				flipH(*dmaB[ch]);
+				apply(jobsB[ch], *dmaB[ch], DMATransform(DMATransform::FLIP_H));
 		});
 		
-		float invert_offset = 10.f * params[INVERT_MODE_PARAM].getValue();
+		DMATransform invert_op(DMATransform::INVERT);
+		invert_op.offset = 10.f * params[INVERT_MODE_PARAM].getValue();
 		onTrigger(INVERT_INPUT, tr_invert, dma_nchan, [&](int ch) {
-			if (dmaF[ch]) {
-				DMAChannel<float> &dma = *dmaF[ch];
-				std::size_t count = dma.size();
-				for (std::size_t i=0; i<count; ++i)
-					dma[i] = invert_offset - dma[i];
-			} else if (dmaB[ch]) {
-				DMAChannel<bool> &dma = *dmaB[ch];
-				std::size_t count = dma.size();
-				for (std::size_t i=0; i<count; ++i)
-					dma[i] = !dma[i];
-			}
+			if (dmaF[ch])
+				apply(jobsF[ch], *dmaF[ch], invert_op);
+			else if (dmaB[ch])
+				apply(jobsB[ch], *dmaB[ch], invert_op);
 		}, tr_invert_btn.process(params[INVERT_PARAM].getValue()));
 
-		float rand_off = params[RAND_MIN_PARAM].getValue();
-		float rand_scl = params[RAND_MAX_PARAM].getValue() - rand_off;
-		onTrigger(RANDOMIZE_INPUT, tr_random, dma_nchan, [rand_off, rand_scl, &dmaF, &dmaB](int ch) {
-			if (dmaF[ch]) {
-				DMAChannel<float> &dma = *dmaF[ch];
-				std::size_t count = dma.size();
-				for (std::size_t i=0; i<count; ++i)
-					dma[i] = rand_off + random::uniform() * rand_scl;
-			} else if (dmaB[ch]) {
-				DMAChannel<bool> &dma = *dmaB[ch];
-				std::size_t count = dma.size();
-				for (std::size_t i=0; i<count; ++i)
-					dma[i] = 20.f * (random::uniform() - 0.5f) < rand_off;
-			}
+		DMATransform random_op(DMATransform::RANDOMIZE);
+		random_op.offset = params[RAND_MIN_PARAM].getValue();
+		random_op.scale = params[RAND_MAX_PARAM].getValue() - random_op.offset;
+		onTrigger(RANDOMIZE_INPUT, tr_random, dma_nchan, [&](int ch) {
+			if (dmaF[ch])
+				apply(jobsF[ch], *dmaF[ch], random_op);
+			else if (dmaB[ch])
+				apply(jobsB[ch], *dmaB[ch], random_op);
 		}, tr_random_btn.process(params[RANDOMIZE_PARAM].getValue()));
+
+		// Queued operations share the budget, starting from a different channel each sample
+		int budget = work_budget ? work_budget : INT_MAX;
+		if (parallel) {
+			for (int ch=0; ch<PORT_MAX_CHANNELS; ++ch) {
+				runJob(jobsF[ch], ch < dma_nchan ? dmaF[ch] : nullptr, budget);
+				runJob(jobsB[ch], ch < dma_nchan ? dmaB[ch] : nullptr, budget);
+			}
+		} else {
+			for (int n=0; n<PORT_MAX_CHANNELS && budget > 0; ++n) {
+				int ch = (next_job + n) % PORT_MAX_CHANNELS;
+				budget -= runJob(jobsF[ch], ch < dma_nchan ? dmaF[ch] : nullptr, budget);
+				budget -= runJob(jobsB[ch], ch < dma_nchan ? dmaB[ch] : nullptr, budget);
+			}
+			next_job = (next_job + 1) % PORT_MAX_CHANNELS;
+		}
+
+		outputs[BUSY_OUTPUT].setChannels(std::max(dma_nchan, 1));
+		for (int ch=0; ch<std::max(dma_nchan, 1); ++ch)
+			outputs[BUSY_OUTPUT].setVoltage((jobsF[ch].queued || jobsB[ch].queued) ? 10.f : 0.f, ch);
+	}
+
+	json_t* dataToJson() override {
+		json_t* root = json_object();
+		json_object_set_new(root, "work_budget", json_integer(work_budget));
+		json_object_set_new(root, "parallel", json_boolean(parallel));
+		return root;
+	}
+
+	void dataFromJson(json_t* root) override {
+		json_t* item = json_object_get(root, "work_budget");
+		if (item)
+			work_budget = json_integer_value(item);
+		item = json_object_get(root, "parallel");
+		if (item)
+			parallel = json_boolean_value(item);
 	}
 };
 
@@ -378,11 +516,11 @@ struct DMAFXWidget : ModuleWidget {
 
 		addParam(createParamCentered<Trimpot>(mm2px(Vec(15.24, 51.55)), module, DMAFX::SCROLL_AMOUNT_CV_PARAM));
 		addParam(createParamCentered<RoundBlackKnob>(mm2px(Vec(23.918, 51.55)), module, DMAFX::SCROLL_AMOUNT_PARAM));
-		addParam(createParamCentered<VCVButton>(mm2px(Vec(14.182, 98.54)), module, DMAFX::INVERT_PARAM));
-		addParam(createParamCentered<CKSS>(mm2px(Vec(20.214, 98.54)), module, DMAFX::INVERT_MODE_PARAM));
-		addParam(createParamCentered<Trimpot>(mm2px(Vec(20.214, 106.401)), module, DMAFX::RAND_MAX_PARAM));
-		addParam(createParamCentered<VCVButton>(mm2px(Vec(14.182, 109.441)), module, DMAFX::RANDOMIZE_PARAM));
-		addParam(createParamCentered<Trimpot>(mm2px(Vec(20.214, 112.481)), module, DMAFX::RAND_MIN_PARAM));
+		addParam(createParamCentered<VCVButton>(mm2px(Vec(14.182, 96.1)), module, DMAFX::INVERT_PARAM));
+		addParam(createParamCentered<CKSS>(mm2px(Vec(20.214, 96.1)), module, DMAFX::INVERT_MODE_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(20.214, 102.56)), module, DMAFX::RAND_MAX_PARAM));
+		addParam(createParamCentered<VCVButton>(mm2px(Vec(14.182, 105.41)), module, DMAFX::RANDOMIZE_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(20.214, 108.26)), module, DMAFX::RAND_MIN_PARAM));
 		addParam(createLightParamCentered<VCVLightLatch<MediumLight<PurpleLight>>>(mm2px(Vec(15.24, 33.77)), module, DMAFX::SCROLL_WRAP_PARAM, DMAFX::SCROLL_WRAP_LIGHT));
 
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(6.35, 24.88)), module, DMAFX::SCROLL_NW_INPUT));
@@ -398,8 +536,10 @@ struct DMAFXWidget : ModuleWidget {
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(21.59, 70.6)), module, DMAFX::ROTATE_CCW_INPUT));
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(11.007, 81.289)), module, DMAFX::FLIP_V_INPUT));
 		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(21.59, 82.348)), module, DMAFX::FLIP_H_INPUT));
-		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(5.821, 98.54)), module, DMAFX::INVERT_INPUT));
-		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(5.821, 109.441)), module, DMAFX::RANDOMIZE_INPUT));
+		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(5.821, 96.1)), module, DMAFX::INVERT_INPUT));
+		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(5.821, 105.41)), module, DMAFX::RANDOMIZE_INPUT));
+
+		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(5.821, 113.8)), module, DMAFX::BUSY_OUTPUT));
 
 		addChild(createLightCentered<SmallLight<BlueLight>>(Vec(8.0, 8.0), module, DMAFX::DMA_CLIENT_LIGHT));
 		addChild(createLightCentered<SmallLight<GreenRedLight>>(Vec(box.size.x - 8.0, 8.0), module, DMAFX::DMA_HOST_LIGHT_G));
@@ -421,6 +561,22 @@ struct DMAFXWidget : ModuleWidget {
 			channel_disp->text = string::f("%d", m->getDMAChannelCount());
 		}
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		auto module = dynamic_cast<DMAFX*>(this->module);
+		static const int budgets[] = {0, 4096, 1024, 256};
+		menu->addChild(new MenuEntry);
+		menu->addChild(createSubmenuItem("Work per sample", module->work_budget ? string::f("%d cells", module->work_budget) : "Unlimited", [=](Menu *menu) {
+			for (int budget : budgets) {
+				std::string label = budget ? string::f("%d cells", budget) : "Unlimited";
+				menu->addChild(createMenuItem(label, (budget == module->work_budget) ? "<" : "", [=]() {
+					module->work_budget = budget;
+				}));
+			}
+		}));
+		menu->addChild(createBoolPtrMenuItem("Run on worker threads", "", &module->parallel));
+		appendDMAProfileMenu(menu, module);
+	}
 };
 
 
@@ -43,6 +43,9 @@ struct Integrator : DMAExpanderModule<float> {
 		LIGHTS_LEN
 	};
 
+	// Our values are column 0 of this channel. The other columns are the host's first
+	// channel, which must have two rows. Direct access to them is forwarded to it, and
+	// commands on them are handed to its owner by acceptDMACommand().
 	struct DMA : DMAChannel<float> {
 		Integrator *module = nullptr;
 		DMAChannel<float> *nextDMA = nullptr;
@@ -53,9 +56,11 @@ struct Integrator : DMAExpanderModule<float> {
 			owner = module;
 		}
 		
+		// Only called from onDMAChainChange(), so the layout never changes while a client
+		// is in acceptDMACommand().
 		void update() {
 			if (module->isHostReady()) {
-				nextDMA = module->getDMAHost()->getDMAChannel(0);
+				nextDMA = module->DMAClient<float>::getDMAChannel(0);
 				insert_channel = !nextDMA || nextDMA->height() != 2;
 			} else {
 				nextDMA = nullptr;
@@ -82,10 +87,21 @@ struct Integrator : DMAExpanderModule<float> {
 		void write(std::size_t index, float value) override {
 			std::size_t col = index % columns;
 			std::size_t row = index / columns;
-			if (col == 0 && row < 2)
+			if (col == 0 && row < 2) {
 				module->values[row] = value;
-			else if (col > 0 && nextDMA && nextDMA->getOwner()->readyForDMA())
+				markDMAChanged(row);
+			} else if (col > 0 && nextDMA && nextDMA->getOwner() && nextDMA->getOwner()->readyForDMA()) {
 				nextDMA->write(col-1, row, value);
+			}
+		}
+
+		// Both counters only move forward, so their sum changes whenever either side of the chain does.
+		uint64_t getDMAVersion() const override {
+			return DMAChannel<float>::getDMAVersion() + (nextDMA ? nextDMA->getDMAVersion() : 0);
+		}
+
+		uint64_t getDMARowVersion(std::size_t row) const override {
+			return DMAChannel<float>::getDMARowVersion(row) + (nextDMA ? nextDMA->getDMARowVersion(row) : 0);
 		}
 	};
 
@@ -93,6 +109,8 @@ struct Integrator : DMAExpanderModule<float> {
 	float values[2];
 	bool wraparound = false;
 	DMA dma;
+	DMACommandQueue<float> dma_queue;
+	DMASnapshot<float> snapshot;
 
 	Integrator() : dma(this) {
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
@@ -116,6 +134,7 @@ struct Integrator : DMAExpanderModule<float> {
 		configOutput(OUT_B_OUTPUT, "Output B");
 		values[0] = values[1] = 0.f;
 		dma.module = this;
+		dma.update();
 		dmaHostLightID = DMA_HOST_LIGHT_G;
 		dmaClientLightID = DMA_CLIENT_LIGHT;
 	}
@@ -129,6 +148,7 @@ struct Integrator : DMAExpanderModule<float> {
 			std::swap(minval, maxval);
 
 		float& value = values[array_index];
+		float last_value = value;
 		if (reset_triggers[array_index].process(inputs[reset].getVoltage()) || params[reset_button].getValue())
 			value = std::min(maxval, std::max(minval, 0.f));
 
@@ -145,6 +165,9 @@ struct Integrator : DMAExpanderModule<float> {
 			}
 		}
 
+		if (value != last_value)
+			dma.markDMAChanged(array_index);
+
 		outputs[output].setVoltage(value);
 		if (wraparound) {
 			lights[max_light].setBrightness(0.5f);
@@ -157,9 +180,15 @@ struct Integrator : DMAExpanderModule<float> {
 
 	void process(const ProcessArgs& args) override {
 		DMAExpanderModule<float>::process(args);
-		dma.update();
+		dma_queue.apply(args.frame, getDMAGeneration());
 		processOne(args, MIN_A_PARAM, MAX_A_PARAM, DELTA_SCALE_A_PARAM, DELTA_SCALE_RANGE_A_PARAM, RESET_A_PARAM, DELTA_A_INPUT, GATE_A_INPUT, RESET_A_INPUT, OUT_A_OUTPUT, MAX_A_LIGHT, MIN_A_LIGHT, 0);
 		processOne(args, MIN_B_PARAM, MAX_B_PARAM, DELTA_SCALE_B_PARAM, DELTA_SCALE_RANGE_B_PARAM, RESET_B_PARAM, DELTA_B_INPUT, GATE_B_INPUT, RESET_B_INPUT, OUT_B_OUTPUT, MAX_B_LIGHT, MIN_B_LIGHT, 1);
+		if (snapshot.isRequested()) {
+			float *out = snapshot.beginPublish(1, 2);
+			out[0] = values[0];
+			out[1] = values[1];
+			snapshot.endPublish();
+		}
 	}
 
 	bool readyForDMA() const override {
@@ -180,7 +209,7 @@ struct Integrator : DMAExpanderModule<float> {
 
 	int getDMAChannelCount() const override {
 		if (isHostReady()) {
-			int host_nchan = getDMAHost()->getDMAChannelCount();
+			int host_nchan = DMAClient<float>::getDMAChannelCount();
 			return host_nchan + (dma.insert_channel ? 1 : 0);
 		} else {
 			return 1;
@@ -188,18 +217,130 @@ struct Integrator : DMAExpanderModule<float> {
 	}
 
 	DMAChannel<float> *getDMAChannel(int num) override {
-		if (num == 0) {
+		if (num == 0)
 			return &dma;
-		} else {
-			DMAHost<float> *host = getDMAHost();
-			if (host)
-				return host->getDMAChannel(num - (dma.insert_channel ? 1 : 0));
-			else
-				return nullptr;
+		else
+			return DMAClient<float>::getDMAChannel(num - (dma.insert_channel ? 1 : 0));
+	}
+
+	DMACommandQueue<float> *getDMACommandQueue() override {
+		return &dma_queue;
+	}
+
+	// Commands on our channel are split on the submitting client's thread: cells of our
+	// values column go to our own queue, and forwarded columns go to the host on our right
+	// as commands on its channel, so each module's memory is only touched from its own
+	// process(). Both parts are applied on the frame after the command was issued, like a
+	// single command. A READ keeps its target contiguous by splitting into runs. Transforms
+	// need both memories at once, so they are refused while columns are forwarded.
+	bool acceptDMACommand(const DMACommand<float> &command, DMAScratch<float> &scratch) override {
+		DMAChannel<float> *next = dma.nextDMA;
+		std::size_t columns = dma.width();
+		if (command.channel != &dma || !next || columns < 2)
+			return DMAHost<float>::acceptDMACommand(command, scratch);
+		if (command.type == DMACommand<float>::TRANSFORM)
+			return false;
+		DMAHost<float> *next_owner = next->getOwner();
+		bool forward = next_owner && next_owner->readyForDMA();
+		std::size_t next_width = next->width();
+		std::size_t next_height = next->height();
+		bool accepted = true;
+		bool checkpoint = command.checkpoint;
+		auto submit = [&](DMACommand<float> &part, bool local) {
+			if (local) {
+				accepted &= DMAHost<float>::acceptDMACommand(part, scratch);
+			} else {
+				part.channel = next;
+				part.checkpoint = checkpoint; // Once for the whole command
+				checkpoint = false;
+				accepted &= next_owner->acceptDMACommand(part, scratch);
+			}
+		};
+
+		if (command.type == DMACommand<float>::WRITE || command.type == DMACommand<float>::READ) {
+			// Each cell is ours (0), forwarded (1) or skipped (2)
+			auto route = [&](int address) {
+				std::size_t col = address % columns;
+				std::size_t row = address / columns;
+				if (col == 0)
+					return 0;
+				return (forward && col - 1 < next_width && row < next_height) ? 1 : 2;
+			};
+			int start = 0;
+			while (start < command.count) {
+				int way = route(command.addresses[start]);
+				DMACommand<float> part = command;
+				part.count = 0;
+				if (command.type == DMACommand<float>::READ)
+					part.target = command.target + start;
+				int i = start;
+				for (; i<command.count && route(command.addresses[i]) == way; ++i) {
+					int address = command.addresses[i];
+					if (way == 1)
+						address = (int)(next_width * (address / columns) + address % columns - 1);
+					part.addresses[part.count] = address;
+					part.values[part.count++] = command.values[i];
+				}
+				start = i;
+				if (way != 2)
+					submit(part, way == 0);
+			}
+			return accepted;
+		}
+
+		// FILL, READ_BLOCK and WRITE_BLOCK, linear or rectangular, go a row at a time
+		if (command.count <= 0)
+			return true;
+		std::size_t first = command.addresses[0];
+		std::size_t last = first + command.count - 1;
+		std::size_t x = first % columns, y = first / columns;
+		std::size_t rows = (command.width > 0) ? command.count / command.width : last / columns - y + 1;
+		for (std::size_t r=0; r<rows; ++r) {
+			std::size_t row = y + r;
+			std::size_t c0, c1, offset;
+			if (command.width > 0) {
+				c0 = x;
+				c1 = x + command.width - 1;
+				offset = r * command.width;
+			} else {
+				c0 = (r == 0) ? x : 0;
+				c1 = (row == last / columns) ? last % columns : columns - 1;
+				offset = columns * row + c0 - first;
+			}
+			DMACommand<float> part = command;
+			part.width = 0;
+			if (c0 == 0) {
+				part.addresses[0] = (int)(columns * row);
+				part.count = 1;
+				part.target = command.target ? command.target + offset : nullptr;
+				part.source = command.source ? command.source + offset : nullptr;
+				submit(part, true);
+				c0 = 1;
+				++offset;
+			}
+			c1 = std::min(c1, next_width);
+			if (!forward || c0 > c1 || row >= next_height)
+				continue;
+			part.addresses[0] = (int)(next_width * row + c0 - 1);
+			part.count = (int)(c1 - c0 + 1);
+			part.target = command.target ? command.target + offset : nullptr;
+			part.source = command.source ? command.source + offset : nullptr;
+			submit(part, false);
 		}
+		return accepted;
+	}
+
+	void processBypass(const ProcessArgs& args) override {
+		dma_queue.apply(args.frame, getDMAGeneration());
 	}
 
-	void onDMAHostChange(const DMAHostChangeEvent &e) override {
+	// Only the values column is our own memory.
+	DMASnapshot<float> *getDMASnapshot(int num) override {
+		return (num == 0) ? &snapshot : nullptr;
+	}
+
+	// Our layout follows the host's first channel, wherever in the chain it changed.
+	void onDMAChainChange() override {
 		dma.update();
 	}
 };
@@ -261,14 +402,18 @@ struct IntegratorWidget : ModuleWidget {
 		ModuleWidget::step();
 		if (module == nullptr) return;
 		auto m = dynamic_cast<Integrator*>(module);
-		for (int i=0; i<2; ++i)
-			value_text[i]->text = string::f("%0.3f", m->values[i]).substr(0, 6);
+		DMASnapshot<float> *snapshot = m->getDMASnapshot(0);
+		if (snapshot->update()) {
+			for (int i=0; i<2; ++i)
+				value_text[i]->text = string::f("%0.3f", snapshot->get(0, i)).substr(0, 6);
+		}
 	}
 
 	void appendContextMenu(Menu* menu) override {
 		if (module == nullptr) return;
 		auto m = dynamic_cast<Integrator*>(module);
 		menu->addChild(createBoolPtrMenuItem("Wraparound", "", &m->wraparound));
+		appendDMAProfileMenu(menu, m);
 	}
 };
 
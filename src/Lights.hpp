@@ -32,6 +32,20 @@ struct TFiveColorLight : TBase {
 };
 using FiveColorLight = TFiveColorLight<>;
 
+// How far (in mm) to inset a light matrix so lights on its edges stay inside the area.
+template <template <typename T> typename TLight>
+struct LightSizingInfo {
+	static constexpr double offset = 0.0;
+};
+template <>
+struct LightSizingInfo<MediumLight> {
+	static constexpr double offset = 1.2;
+};
+template <>
+struct LightSizingInfo<LargeLight> {
+	static constexpr double offset = 2.0;
+};
+
 template <typename TLight = SmallLight<TrueRGBLight>>
 Widget* createLightMatrix(Vec topLeft, Vec size, Module* module, int firstID, int width, int height) {
 	double x_increment = size.x / (width - 1);
@@ -1,7 +1,6 @@
 #include "plugin.hpp"
 #include "DMA.hpp"
-#include <bitset>
-#include <cstdlib>
+#include <algorithm>
 
 using namespace sparkette;
 
@@ -9,6 +8,8 @@ struct Microcosm : DMAHostModule<bool> {
 	static constexpr int GRID_WIDTH = 5;
 	static constexpr int GRID_HEIGHT = 5;
 	static constexpr int CELL_COUNT = GRID_WIDTH * GRID_HEIGHT;
+	static constexpr int ROW_WORDS = DMABitChannel::wordsPerRow(GRID_WIDTH);
+	static constexpr int WORD_COUNT = ROW_WORDS * GRID_HEIGHT;
 
 	enum ParamId {
 		CLOCK_ENABLE_PARAM,
@@ -40,28 +41,19 @@ struct Microcosm : DMAHostModule<bool> {
 
 	dsp::SchmittTrigger t_clock, t_save, t_restore, t_random, t_clear;
 	dsp::SchmittTrigger t_cell_toggle[CELL_COUNT];
-	std::bitset<CELL_COUNT> field, saved;
-
-	struct DMA : DMAChannel<bool> {
-		std::bitset<CELL_COUNT> &bitset;
-		DMA(std::bitset<CELL_COUNT> &bitset, DMAHost<bool> *owner) : bitset(bitset) {
-			columns = GRID_WIDTH;
-			count = CELL_COUNT;
-			this->owner = owner;
-		}
-
-		bool read(std::size_t index) const override {
-			return bitset[index];
-		}
-
-		void write(std::size_t index, bool value) override {
-			bitset[index] = value;
-		}
-	};
-
-	DMA fieldDMA, savedDMA;
+	uint64_t field[WORD_COUNT] = {};
+	uint64_t saved[WORD_COUNT] = {};
+	DMABitChannel fieldDMA, savedDMA;
+	DMACommandQueue<bool> dma_queue;
+	DMASnapshot<bool> snapshots[2];
+
+	static bool getCell(const uint64_t *words, int x, int y) {
+		return (words[ROW_WORDS * y + x / 64] >> (x % 64)) & 1;
+	}
 
-	Microcosm() : fieldDMA(field, this), savedDMA(saved, this) {
+	Microcosm() {
+		fieldDMA.setup(this, GRID_WIDTH, GRID_HEIGHT, field);
+		savedDMA.setup(this, GRID_WIDTH, GRID_HEIGHT, saved);
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
 		configSwitch(CLOCK_ENABLE_PARAM, 0.f, 1.f, 1.f, "Clock", {"Disabled", "Enabled"});
 		configParam(SAVE_PARAM, 0.f, 1.f, 0.f, "Save");
@@ -87,10 +79,11 @@ struct Microcosm : DMAHostModule<bool> {
 	}
 
 	void initSaved() {
-		saved.reset();
-		saved.set(11); saved.set(12); saved.set(13);
-		saved.set(16);
-		               saved.set(22);
+		std::fill(saved, saved + WORD_COUNT, 0);
+		savedDMA.markDMAChanged(0, GRID_HEIGHT);
+		savedDMA.set(11, true); savedDMA.set(12, true); savedDMA.set(13, true);
+		savedDMA.set(16, true);
+		                        savedDMA.set(22, true);
 	}
 
 	void onReset(const ResetEvent& e) override {
@@ -98,27 +91,28 @@ struct Microcosm : DMAHostModule<bool> {
 	}
 
 	void process(const ProcessArgs& args) override {
-		std::bitset<CELL_COUNT> scratch(field);
+		dma_queue.apply(args.frame, getDMAGeneration());
+		uint64_t scratch[WORD_COUNT];
+		std::copy(field, field + WORD_COUNT, scratch);
 		if (t_restore.process(inputs[RESTORE_INPUT].getVoltage() + params[RESTORE_PARAM].getValue()))
-			field = saved;
-		if (t_save.process(inputs[SAVE_INPUT].getVoltage() + params[SAVE_PARAM].getValue()))
-			saved = scratch;
+			std::copy(saved, saved + WORD_COUNT, field);
+		if (t_save.process(inputs[SAVE_INPUT].getVoltage() + params[SAVE_PARAM].getValue())) {
+			std::copy(scratch, scratch + WORD_COUNT, saved);
+			savedDMA.markDMAChanged(0, GRID_HEIGHT);
+		}
 		if (t_random.process(inputs[RANDOM_INPUT].getVoltage() + params[RANDOM_PARAM].getValue())) {
-			for (int i=0; i<CELL_COUNT; ++i) {
-				if (std::rand() % 2)
-					field.set(i);
-				else
-					field.reset(i);
-			}
+			for (int i=0; i<WORD_COUNT; ++i)
+				field[i] = random::u64();
+			fieldDMA.clearPadding();
 		}
 		if (t_clear.process(inputs[CLEAR_INPUT].getVoltage() + params[CLEAR_PARAM].getValue()))
-			field.reset();
+			std::fill(field, field + WORD_COUNT, 0);
 
 		bool clock = t_clock.process(inputs[CLOCK_INPUT].getVoltage()) && params[CLOCK_ENABLE_PARAM].getValue() > 0.5f;
 
 		for (int i=0; i<CELL_COUNT; ++i) {
 			if (t_cell_toggle[i].process(inputs[CELL_INPUTS_START+i].getVoltage() + params[CELL_BUTTONS_START+i].getValue()))
-				field.flip(i);
+				fieldDMA.set(i, !fieldDMA.get(i));
 
 			if (clock) {
 				int x = i % GRID_WIDTH;
@@ -132,26 +126,33 @@ struct Microcosm : DMAHostModule<bool> {
 						else if (xx >= GRID_WIDTH) xx = 0;
 						if (yy < 0) yy = GRID_HEIGHT-1;
 						else if (yy >= GRID_HEIGHT) yy = 0;
-						if ((x != xx || y != yy) && scratch[GRID_WIDTH * yy + xx])
+						if ((x != xx || y != yy) && getCell(scratch, xx, yy))
 							++neighbors;
 					}
 				}
 				if (neighbors < 2 || neighbors > 3)
-					field.reset(i);
+					fieldDMA.set(i, false);
 				else if (neighbors == 3)
-					field.set(i);
+					fieldDMA.set(i, true);
 			}
 
-			lights[CELL_LIGHTS_START+i].setBrightnessSmooth((float)field[i], args.sampleTime);
-			outputs[CELL_OUTPUTS_START+i].setVoltage(10.f * field[i]);
+			bool cell = fieldDMA.get(i);
+			lights[CELL_LIGHTS_START+i].setBrightnessSmooth((float)cell, args.sampleTime);
+			outputs[CELL_OUTPUTS_START+i].setVoltage(10.f * cell);
 		}
+
+		for (int y=0; y<GRID_HEIGHT; ++y)
+			if (!std::equal(field + ROW_WORDS * y, field + ROW_WORDS * (y+1), scratch + ROW_WORDS * y))
+				fieldDMA.markDMAChanged(y);
+		snapshots[0].publish(fieldDMA);
+		snapshots[1].publish(savedDMA);
 	}
 
 	json_t* dataToJson() override {
 		json_t* root = json_object();
 		json_t* array = json_array();
 		for (int i=0; i<CELL_COUNT; ++i)
-			json_array_append_new(array, json_boolean(saved[i]));
+			json_array_append_new(array, json_boolean(savedDMA.get(i)));
 		json_object_set_new(root, "saved_field", array);
 		return root;
 	}
@@ -160,8 +161,9 @@ struct Microcosm : DMAHostModule<bool> {
 		json_t* item = json_object_get(root, "saved_field");
 		if (item) {
 			for (int i=0; i<CELL_COUNT; ++i) {
-				saved[i] = json_boolean_value(json_array_get(item, i));
+				savedDMA.set(i, json_boolean_value(json_array_get(item, i)));
 			}
+			savedDMA.markDMAChanged(0, GRID_HEIGHT);
 		}
 	}
 
@@ -176,6 +178,19 @@ struct Microcosm : DMAHostModule<bool> {
 			default: return nullptr;
 		}
 	}
+
+	DMACommandQueue<bool> *getDMACommandQueue() override {
+		return &dma_queue;
+	}
+
+	DMASnapshot<bool> *getDMASnapshot(int num) override {
+		return (num == 0 || num == 1) ? &snapshots[num] : nullptr;
+	}
+
+	// Clients wait on queued commands being applied, so this carries on while bypassed.
+	void processBypass(const ProcessArgs& args) override {
+		dma_queue.apply(args.frame, getDMAGeneration());
+	}
 };
 
 
@@ -217,6 +232,11 @@ struct MicrocosmWidget : ModuleWidget {
 			addChild(createLightCentered<LargeLight<YellowLight>>(mm2px(Vec(x, y)), module, Microcosm::CELL_LIGHTS_START+i));
 		}
 	}
+
+	void appendContextMenu(Menu* menu) override {
+		if (module)
+			appendDMAProfileMenu(menu, module);
+	}
 };
 
 
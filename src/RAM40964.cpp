@@ -8,10 +8,23 @@
 
 using namespace sparkette;
 
-struct RAM40964 : DMAHostModule<float> {
-	static constexpr int MATRIX_WIDTH = 64;
-	static constexpr int MATRIX_HEIGHT = 64;
+// The panel has ports, switches and display modes for four planes, so only the matrix
+// size is a parameter. Matrices larger than 64x64 are shown downsampled, each light
+// averaging a block of cells. Planar memory keeps each plane contiguous, so its channel
+// has stride 1; otherwise the planes of a cell are stored together.
+template <int Width, int Height, bool Planar = true>
+struct RAM : DMAHostModule<float> {
+	static constexpr int MATRIX_WIDTH = Width;
+	static constexpr int MATRIX_HEIGHT = Height;
 	static constexpr int PLANE_COUNT = 4;
+	static constexpr int DISPLAY_WIDTH = Width < 64 ? Width : 64;
+	static constexpr int DISPLAY_HEIGHT = Height < 64 ? Height : 64;
+	static constexpr int BLOCK_WIDTH = Width / DISPLAY_WIDTH;
+	static constexpr int BLOCK_HEIGHT = Height / DISPLAY_HEIGHT;
+	static_assert(Width % DISPLAY_WIDTH == 0 && Height % DISPLAY_HEIGHT == 0, "The display must divide the matrix evenly.");
+	static constexpr int PLANE_SIZE = (Width * Height + 15) / 16 * 16; // Whole cache lines
+	static constexpr int CELL_STRIDE = Planar ? 1 : PLANE_COUNT; // Between cells of a plane
+	static constexpr int PLANE_OFFSET = Planar ? PLANE_SIZE : 1; // Between planes of a cell
 
 	enum ParamId {
 		X_PARAM,
@@ -73,35 +86,69 @@ struct RAM40964 : DMAHostModule<float> {
 		CH_RW_LIGHTS_G = CH_PLANE3_LIGHTS_G + 2*PORT_MAX_CHANNELS,
 		CH_RW_LIGHTS_R,
 		MATRIX_LIGHT_START = CH_RW_LIGHTS_G + 2*PORT_MAX_CHANNELS,
-		DMA_LIGHT_G = MATRIX_LIGHT_START + 3*MATRIX_WIDTH*MATRIX_HEIGHT,
+		DMA_LIGHT_G = MATRIX_LIGHT_START + 3*DISPLAY_WIDTH*DISPLAY_HEIGHT,
 		DMA_LIGHT_R,
 		PHASOR_ADDR_LIGHT,
 		LIGHTS_LEN
 	};
 
-	struct DMA : DMAChannel<float> {
-		bool write_enable = true;
-		void write(std::size_t index, float value) override {
-			if (write_enable)
-				DMAChannel<float>::write(index, value);
-		}
-	};
+	typedef DMAStridedChannel<float, CELL_STRIDE> DMA;
 
-	float data[MATRIX_WIDTH*MATRIX_HEIGHT][PLANE_COUNT];
+	std::unique_ptr<float[]> storage;
+	float *data; // Storage aligned to a cache line
 	int dispmode = 0;
 	float brightness = 0.5f;
 	dsp::SchmittTrigger clear_trigger;
 	bool fade_lights = true;
-	float fade_sampleTime = 0.f;
-	bool data_dirty = false;
 	DMA dma[PLANE_COUNT];
+	DMACommandQueue<float> dma_queue;
+	DMASnapshot<float> snapshots[PLANE_COUNT];
+	DMAUndo<float> undo{PLANE_COUNT, MATRIX_WIDTH, MATRIX_HEIGHT};
+
+	// Matrix lights are refreshed from a dirty set, at most LIGHT_BUDGET cells' worth per
+	// sample, so display cost doesn't grow with how much was written. Each display row has
+	// a mask of dirty columns, set by DMA write events and whole-memory changes, and a mask
+	// of dirty rows summarises them. DMA writes can come from other modules' threads, hence
+	// the atomics; cells written by process() are gathered separately without them. Lights
+	// still fading toward their targets are kept aside and made dirty again every FADE_FRAMES.
+	static constexpr int LIGHT_BUDGET = 64; // Cells per sample
+	static constexpr int SWEEP_FRAMES = Width * Height / LIGHT_BUDGET; // To refresh every light
+	static constexpr int FADE_FRAMES = SWEEP_FRAMES > 128 ? SWEEP_FRAMES : 128;
+	static_assert(DISPLAY_WIDTH <= 64 && DISPLAY_HEIGHT <= 64, "Dirty masks are 64 bits.");
+	std::atomic<uint64_t> dirty_lights[DISPLAY_HEIGHT];
+	std::atomic<uint64_t> dirty_rows;
+	uint64_t written_lights[DISPLAY_HEIGHT] = {};
+	uint64_t written_rows = 0;
+	uint64_t fading_lights[DISPLAY_HEIGHT] = {};
+	uint64_t fading_rows = 0;
+	int64_t fade_frame = 0; // When fading lights were last made dirty
+	uint32_t light_frames[DISPLAY_WIDTH*DISPLAY_HEIGHT] = {}; // Frame each light was last refreshed at
+	int light_cursor = 0; // Display row the next refresh starts at
+
 	dsp::PulseGenerator dma_write_led_pulse;
 	bool save_memory = false;
-
-	RAM40964() {
+	bool save_float16 = false;
+
+	// Rack calls dataToJson() on every autosave, so memory is packed a row at a time and
+	// each row is kept, with the row version it was packed at, until it is written again.
+	// The rows of a plane together are one valid packed stream.
+	struct PackedRow {
+		bool valid = false;
+		uint64_t version = 0;
+		std::vector<uint8_t> bytes;
+	};
+	PackedRow packed_rows[PLANE_COUNT][MATRIX_HEIGHT];
+	bool packed_float16 = false;
+	std::string packed_memory; // Base64 of every row; empty until first packed
+
+	RAM() : storage(new float[PLANE_COUNT*PLANE_SIZE + 16]) {
+		data = (float *)(((uintptr_t)storage.get() + 63) & ~(uintptr_t)63);
+		for (int dy=0; dy<DISPLAY_HEIGHT; ++dy)
+			dirty_lights[dy].store(0, std::memory_order_relaxed);
+		dirty_rows.store(0, std::memory_order_relaxed);
 		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
-		configParam(X_PARAM, 0.f, 63.f, 0.f, "X address");
-		configParam(Y_PARAM, 0.f, 63.f, 0.f, "Y address");
+		configParam(X_PARAM, 0.f, MATRIX_WIDTH - 1.f, 0.f, "X address");
+		configParam(Y_PARAM, 0.f, MATRIX_HEIGHT - 1.f, 0.f, "Y address");
 		configParam(DATA0_PARAM, 0.f, 1.f, 1.f, "Plane 0 value");
 		configParam(DATA1_PARAM, 0.f, 1.f, 1.f, "Plane 1 value");
 		configParam(DATA2_PARAM, 0.f, 1.f, 1.f, "Plane 2 value");
@@ -137,62 +184,183 @@ struct RAM40964 : DMAHostModule<float> {
 		clearData();
 
 		for (int i=0; i<PLANE_COUNT; ++i)
-			dma[i].setup(this, MATRIX_WIDTH, MATRIX_HEIGHT, &data[0][i], PLANE_COUNT);
+			dma[i].setup(this, MATRIX_WIDTH, MATRIX_HEIGHT, &cell(0, i));
 
 		dmaClientLightID = DMA_LIGHT_G;
 	}
 
+	float &cell(int address, int plane) {
+		return data[address*CELL_STRIDE + plane*PLANE_OFFSET];
+	}
+
 	void onDMAWrite(const DMAWriteEvent<float> &e) override {
-		data_dirty = true;
 		dma_write_led_pulse.trigger();
+		markLightsDirty(e.x, e.y, e.width, e.height);
+	}
+
+	void onDMACheckpoint(DMAChannel<float> *channel) override {
+		undo.checkpoint(dma, "transform memory");
+	}
+
+	void restoreUndo() {
+		undo.restore(dma, [this](int plane, std::size_t row, const float *values) {
+			for (int x=0; x<MATRIX_WIDTH; ++x)
+				cell(MATRIX_WIDTH*row + x, plane) = values[x];
+			dma[plane].markDMAChanged(row);
+			markLightsDirty(0, row, MATRIX_WIDTH, 1);
+		});
 	}
 
 	void clearData() {
-		std::memset(data, 0, sizeof(data));
+		std::memset(data, 0, sizeof(float) * PLANE_COUNT*PLANE_SIZE);
+		markAllChanged();
+	}
+
+	void markAllChanged() {
+		for (int i=0; i<PLANE_COUNT; ++i)
+			dma[i].markDMAChanged(0, MATRIX_HEIGHT);
+		markLightsDirty(0, 0, MATRIX_WIDTH, MATRIX_HEIGHT);
 	}
 
-	void updateDataLights(int address, float sampleTime) {
-		int light_base = MATRIX_LIGHT_START + 3*address;
+	// Marks the lights showing a rectangle of cells for the next refreshes.
+	void markLightsDirty(std::size_t x, std::size_t y, std::size_t width, std::size_t height) {
+		if (x >= (std::size_t)MATRIX_WIDTH || y >= (std::size_t)MATRIX_HEIGHT || width == 0 || height == 0)
+			return;
+		int dx0 = x / BLOCK_WIDTH;
+		int dx1 = (std::min(x + width, (std::size_t)MATRIX_WIDTH) - 1) / BLOCK_WIDTH;
+		int dy0 = y / BLOCK_HEIGHT;
+		int dy1 = (std::min(y + height, (std::size_t)MATRIX_HEIGHT) - 1) / BLOCK_HEIGHT;
+		uint64_t mask = (dx1 - dx0 == 63 ? ~(uint64_t)0 : ((uint64_t)1 << (dx1 - dx0 + 1)) - 1) << dx0;
+		uint64_t rows = 0;
+		for (int dy=dy0; dy<=dy1; ++dy) {
+			dirty_lights[dy].fetch_or(mask, std::memory_order_relaxed);
+			rows |= (uint64_t)1 << dy;
+		}
+		dirty_rows.fetch_or(rows, std::memory_order_relaxed); // After the rows, so none is missed
+	}
+
+	void markLightWritten(int address) {
+		int dx = address % MATRIX_WIDTH / BLOCK_WIDTH;
+		int dy = address / MATRIX_WIDTH / BLOCK_HEIGHT;
+		written_lights[dy] |= (uint64_t)1 << dx;
+		written_rows |= (uint64_t)1 << dy;
+	}
+
+	// Refreshes dirty lights until the budget is spent, resuming where the last call left
+	// off so that every row gets its turn.
+	void refreshDirtyLights(int64_t frame, float sampleTime) {
+		if (fading_rows && frame - fade_frame >= FADE_FRAMES) {
+			for (int dy=0; dy<DISPLAY_HEIGHT; ++dy) {
+				if (fading_lights[dy])
+					dirty_lights[dy].fetch_or(fading_lights[dy], std::memory_order_relaxed);
+				fading_lights[dy] = 0;
+			}
+			dirty_rows.fetch_or(fading_rows, std::memory_order_relaxed);
+			fading_rows = 0;
+			fade_frame = frame;
+		}
+		if (!written_rows && !dirty_rows.load(std::memory_order_relaxed))
+			return;
+		uint64_t rows = dirty_rows.exchange(0, std::memory_order_relaxed) | written_rows;
+		written_rows = 0;
+		uint64_t pending = 0;
+		int budget = LIGHT_BUDGET;
+		int start = light_cursor;
+		for (int n=0; n<DISPLAY_HEIGHT; ++n) {
+			int dy = (start + n) % DISPLAY_HEIGHT;
+			uint64_t row_bit = (uint64_t)1 << dy;
+			if (!(rows & row_bit))
+				continue;
+			if (budget <= 0) {
+				pending |= row_bit;
+				continue;
+			}
+			uint64_t mask = written_lights[dy];
+			written_lights[dy] = 0;
+			if (dirty_lights[dy].load(std::memory_order_relaxed))
+				mask |= dirty_lights[dy].exchange(0, std::memory_order_relaxed);
+			while (mask && budget > 0) {
+				int dx = __builtin_ctzll(mask);
+				mask &= mask - 1;
+				// Fading is paced by the time since the light was last refreshed, capped at a
+				// sweep so that a light left alone for a while doesn't jump to its target.
+				uint32_t &last_frame = light_frames[DISPLAY_WIDTH*dy + dx];
+				uint32_t elapsed = (uint32_t)frame - last_frame;
+				if (elapsed > (uint32_t)FADE_FRAMES)
+					elapsed = FADE_FRAMES;
+				last_frame = (uint32_t)frame;
+				float fade_time = std::min(elapsed * sampleTime, 1.f / 60.f); // Keeps each step short of the target
+				if (!updateDisplayLight(dx, dy, fade_time)) {
+					fading_lights[dy] |= (uint64_t)1 << dx;
+					fading_rows |= row_bit;
+				}
+				budget -= BLOCK_WIDTH * BLOCK_HEIGHT;
+			}
+			if (mask) {
+				dirty_lights[dy].fetch_or(mask, std::memory_order_relaxed);
+				pending |= row_bit;
+			}
+			// Resume at a row left unfinished, otherwise at the one after
+			light_cursor = mask ? dy : (dy + 1) % DISPLAY_HEIGHT;
+		}
+		if (pending)
+			dirty_rows.fetch_or(pending, std::memory_order_relaxed);
+	}
+
+	// Shows the average of the light's block of cells, which is a single cell up to 64x64.
+	// Returns false while the light is still fading toward it.
+	bool updateDisplayLight(int dx, int dy, float sampleTime) {
+		int light_base = MATRIX_LIGHT_START + 3*(DISPLAY_WIDTH*dy + dx);
 		int dispmode = (int)params[DISPMODE_PARAM].getValue();
+		float sum[3] = {};
+		for (int y=dy*BLOCK_HEIGHT; y<(dy+1)*BLOCK_HEIGHT; ++y) {
+			for (int x=dx*BLOCK_WIDTH; x<(dx+1)*BLOCK_WIDTH; ++x) {
+				int address = MATRIX_WIDTH*y + x;
+				if (dispmode == 2) {
+					float rgb[3];
+					hsvToRgb(cell(address, 0) / 10.f, cell(address, 1) / 10.f, cell(address, 2) / 10.f, rgb[0], rgb[1], rgb[2]);
+					for (int i=0; i<3; ++i)
+						sum[i] += rgb[i];
+				} else if (dispmode == 1) {
+					for (int i=0; i<3; ++i)
+						sum[i] += cell(address, i) / 10.f;
+				} else {
+					sum[0] += cell(address, 3) / 10.f;
+				}
+			}
+		}
+		float scale = 1.f / (BLOCK_WIDTH * BLOCK_HEIGHT);
+		float target[3];
 		if (dispmode > 0) {
-			float rgb[3];
-			if (dispmode == 2)
-				hsvToRgb(data[address][0] / 10.f, data[address][1] / 10.f, data[address][2] / 10.f, rgb[0], rgb[1], rgb[2]);
-			else
-				for (int i=0; i<3; ++i)
-					rgb[i] = data[address][i] / 10.f;
 			for (int i=0; i<3; ++i)
-				if (fade_lights)
-					lights[light_base+i].setBrightnessSmooth(rgb[i] * brightness, sampleTime);
-				else
-					lights[light_base+i].setBrightness(rgb[i] * brightness);
+				target[i] = sum[i] * scale * brightness;
 		} else {
-			float value = data[address][3] / 10.f;
+			float value = sum[0] * scale;
+			target[0] = -value * brightness;
+			target[1] = value * brightness;
+			target[2] = 0.f;
+		}
+		bool settled = true;
+		for (int i=0; i<3; ++i) {
 			if (fade_lights) {
-				lights[light_base+0].setBrightnessSmooth(-value * brightness, sampleTime);
-				lights[light_base+1].setBrightnessSmooth(value * brightness, sampleTime);
-				lights[light_base+2].setBrightnessSmooth(0.f, sampleTime);
+				lights[light_base+i].setBrightnessSmooth(target[i], sampleTime);
+				settled &= std::fabs(lights[light_base+i].getBrightness() - target[i]) < 1e-3f;
 			} else {
-				lights[light_base+0].setBrightness(-value * brightness);
-				lights[light_base+1].setBrightness(value * brightness);
-				lights[light_base+2].setBrightness(0.f);
+				lights[light_base+i].setBrightness(target[i]);
 			}
 		}
-	}
-
-	void updateDataLights(float sampleTime) {
-		for (int i=0; i<MATRIX_WIDTH*MATRIX_HEIGHT; ++i)
-			updateDataLights(i, sampleTime);
-		data_dirty = false;
+		return settled;
 	}
 
 	void process(const ProcessArgs& args) override {
 		bool plane_write_enable[PLANE_COUNT];
 		for (int i=0; i<PLANE_COUNT; ++i) {
 			float p = params[WRITE0_PARAM+i].getValue();
-			dma[i].write_enable = p > 0.5f;
+			dma[i].setWriteEnable(p > 0.5f);
 			plane_write_enable[i] = p > 1.5f;
 		}
+		restoreUndo();
+		dma_queue.apply(args.frame, getDMAGeneration());
 			
 		// Process phasor input/outputs
 		int phasor_nchan = inputs[PHASOR_INPUT].getChannels();
@@ -239,8 +407,8 @@ struct RAM40964 : DMAHostModule<float> {
 
 		// Clear data on trigger
 		if (clear_trigger.process(inputs[CLEAR_INPUT].getVoltage()) || params[CLEAR_PARAM].getValue() > 0.5f) {
+			undo.checkpoint(dma, "clear memory");
 			clearData();
-			data_dirty = true;
 		}
 
 		// Determine which addresses to read/write
@@ -303,14 +471,18 @@ struct RAM40964 : DMAHostModule<float> {
 			if (i < write_count) {
 				if (write_gates[i] > 0.5f || write_all) {
 					wrote_some = true;
+					bool wrote_cell = false;
 					for (int j=0; j<PLANE_COUNT; ++j) {
 						if (!plane_write_enable[j])
 							continue;
 						if (i < planes_nchan[j])
 							plane_lastval[j] = to_write[j][i] * params[DATA0_PARAM+j].getValue();
-						data[addresses_w[i]][j] = plane_lastval[j];
-						updateDataLights(addresses_w[i], args.sampleTime);
+						cell(addresses_w[i], j) = plane_lastval[j];
+						dma[j].markDMAChanged(addresses_w[i] / MATRIX_WIDTH);
+						wrote_cell = true;
 					}
+					if (wrote_cell)
+						markLightWritten(addresses_w[i]);
 				}
 			}
 		}
@@ -347,62 +519,99 @@ struct RAM40964 : DMAHostModule<float> {
 		const int plane_light_starts[4] = {CH_PLANE0_LIGHTS_G, CH_PLANE1_LIGHTS_G, CH_PLANE2_LIGHTS_G, CH_PLANE3_LIGHTS_G};
 		for (int i=0; i<PLANE_COUNT; ++i) {
 			float voltages[PORT_MAX_CHANNELS];
-			for (int j=0; j<addr_count_r; ++j)
-				voltages[j] = data[addresses_r[j]][i];
+			dma[i].readGather(addresses_r, addr_count_r, voltages);
 			outputs[DATA0_OUTPUT+i].setChannels(addr_count_r);
 			outputs[DATA0_OUTPUT+i].writeVoltages(voltages);
+			float monitor_values[PORT_MAX_CHANNELS];
+			dma[i].readGather(write_monitor ? addresses_w : addresses_r, PORT_MAX_CHANNELS, monitor_values);
 			for (int j=0; j<PORT_MAX_CHANNELS; ++j) {
 				int light_base = plane_light_starts[i] + 2*j;
-				const int* addr_source = write_monitor ? addresses_w : addresses_r;
-				float value = data[addr_source[j]][i] / 10;
+				float value = monitor_values[j] / 10;
 				lights[light_base+0].setBrightnessSmooth(value, args.sampleTime);
 				lights[light_base+1].setBrightnessSmooth(-value, args.sampleTime);
 			}
 		}
 
-		// Update entire matrix display if necessary
-		if (fade_lights) {
-			fade_sampleTime += args.sampleTime;
-			if (args.frame % 128 == 0) {
-				updateDataLights(fade_sampleTime);
-				fade_sampleTime = 0.f;
-			}
-		} else if (data_dirty || brightness != last_brightness || dispmode != last_dispmode) {
-			updateDataLights(args.sampleTime);
-		}
+		// Refresh the matrix display, all of it if the way cells are shown changed
+		if (brightness != last_brightness || dispmode != last_dispmode)
+			markLightsDirty(0, 0, MATRIX_WIDTH, MATRIX_HEIGHT);
+		refreshDirtyLights(args.frame, args.sampleTime);
 
 		lights[DMA_LIGHT_R].setBrightnessSmooth(dma_write_led_pulse.process(args.sampleTime) ? 1.f : 0.f, args.sampleTime);
+
+		undo.commit(dma);
+		for (int i=0; i<PLANE_COUNT; ++i)
+			snapshots[i].publish(dma[i]);
 	}
 
 	json_t* dataToJson() override {
 		json_t* root = json_object();
 		json_object_set_new(root, "fade_lights", json_boolean(fade_lights));
 		if (save_memory) {
-			json_t* array = json_array();
-			for (int i=0; i<PLANE_COUNT; ++i) {
-				json_t* plane = json_array();
-				for (int j=0; j<MATRIX_WIDTH*MATRIX_HEIGHT; ++j)
-					json_array_append_new(plane, json_real(data[j][i]));
-				json_array_append_new(array, plane);
-			}
-			json_object_set_new(root, "memory_contents", array);
+			json_object_set_new(root, "memory_contents", json_string(packMemory().c_str()));
+			json_object_set_new(root, "memory_format", json_string(save_float16 ? "float16" : "float32"));
 		}
 		return root;
 	}
 
+	// All planes packed one after another, repacking only rows written since the last call.
+	// Each row's version is read before its data, so a write racing with this one leaves
+	// the row stale and it is packed again next time.
+	const std::string &packMemory() {
+		bool format_changed = save_float16 != packed_float16;
+		bool changed = format_changed || packed_memory.empty();
+		packed_float16 = save_float16;
+		for (int i=0; i<PLANE_COUNT; ++i) {
+			for (int y=0; y<MATRIX_HEIGHT; ++y) {
+				PackedRow &row = packed_rows[i][y];
+				uint64_t version = dma[i].getDMARowVersion(y);
+				if (row.valid && row.version == version && !format_changed)
+					continue;
+				row.valid = true;
+				row.version = version;
+				row.bytes.clear();
+				packFloats(row.bytes, &cell(MATRIX_WIDTH*y, i), MATRIX_WIDTH, CELL_STRIDE, save_float16);
+				changed = true;
+			}
+		}
+		if (changed) {
+			std::vector<uint8_t> packed;
+			for (int i=0; i<PLANE_COUNT; ++i)
+				for (int y=0; y<MATRIX_HEIGHT; ++y)
+					packed.insert(packed.end(), packed_rows[i][y].bytes.begin(), packed_rows[i][y].bytes.end());
+			packed_memory = string::toBase64(packed.data(), packed.size());
+		}
+		return packed_memory;
+	}
+
 	void dataFromJson(json_t* root) override {
 		json_t* item = json_object_get(root, "fade_lights");
 		if (item)
 			fade_lights = json_boolean_value(item);
 
 		item = json_object_get(root, "memory_contents");
-		if (item) {
+		if (json_is_string(item)) {
+			save_memory = true;
+			const char* format = json_string_value(json_object_get(root, "memory_format"));
+			save_float16 = format && std::string(format) == "float16";
+			std::vector<uint8_t> packed = string::fromBase64(json_string_value(item));
+			std::size_t offset = 0;
+			for (int i=0; i<PLANE_COUNT; ++i) {
+				std::size_t used = unpackFloats(packed.data() + offset, packed.size() - offset, &cell(0, i), MATRIX_WIDTH*MATRIX_HEIGHT, CELL_STRIDE, save_float16);
+				if (!used)
+					break;
+				offset += used;
+			}
+			markAllChanged();
+		} else if (item) {
+			// Patches saved before packing have an array of numbers per plane
 			save_memory = true;
 			for (int i=0; i<PLANE_COUNT; ++i) {
 				json_t* plane = json_array_get(item, i);
 				for (int j=0; j<MATRIX_WIDTH*MATRIX_HEIGHT; ++j)
-					data[j][i] = (float)json_real_value(json_array_get(plane, j));
+					cell(j, i) = (float)json_real_value(json_array_get(plane, j));
 			}
+			markAllChanged();
 		} else {
 			save_memory = false;
 		}
@@ -415,82 +624,121 @@ struct RAM40964 : DMAHostModule<float> {
 	DMAChannel<float> *getDMAChannel(int num) override {
 		return &dma[num];
 	}
+
+	DMACommandQueue<float> *getDMACommandQueue() override {
+		return &dma_queue;
+	}
+
+	DMASnapshot<float> *getDMASnapshot(int num) override {
+		return &snapshots[num];
+	}
+
+	DMAUndo<float> *getDMAUndo() override {
+		return &undo;
+	}
+
+	// Clients wait on queued commands being applied, so this carries on while bypassed.
+	void processBypass(const ProcessArgs& args) override {
+		restoreUndo();
+		dma_queue.apply(args.frame, getDMAGeneration());
+		undo.commit(dma);
+	}
 };
 
 
-struct RAM40964Widget : ModuleWidget {
-	RAM40964Widget(RAM40964* module) {
+typedef RAM<64, 64> RAM40964;
+
+template <int Width, int Height, template <typename T> typename TLight = TinySimpleLight>
+struct RAMWidget : ModuleWidget {
+	using ModuleType = RAM<Width, Height>;
+	RAMWidget(ModuleType* module) {
 		setModule(module);
-		setPanel(createPanel(asset::plugin(pluginInstance, "res/RAM40964.svg")));
+		// Every size shares one panel; only the title and the row offset label differ
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/RAM.svg")));
+		SvgWidget* labels = createWidget<SvgWidget>(Vec(0, 0));
+		labels->setSvg(Svg::load(asset::plugin(pluginInstance, string::f("res/RAM%d%d_labels.svg", Width * Height, (int)ModuleType::PLANE_COUNT))));
+		addChild(labels);
 
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
 		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
 
-		addParam(createParamCentered<Rogan1PYellow>(mm2px(Vec(7.62, 10.91)), module, RAM40964::X_PARAM));
-		addParam(createParamCentered<Rogan1PPurple>(mm2px(Vec(7.62, 23.61)), module, RAM40964::Y_PARAM));
-		addParam(createParamCentered<Trimpot>(mm2px(Vec(97.655, 60.816)), module, RAM40964::DATA0_PARAM));
-		addParam(createParamCentered<Trimpot>(mm2px(Vec(97.655, 73.516)), module, RAM40964::DATA1_PARAM));
-		addParam(createParamCentered<Trimpot>(mm2px(Vec(97.655, 86.216)), module, RAM40964::DATA2_PARAM));
-		addParam(createParamCentered<Trimpot>(mm2px(Vec(97.655, 98.916)), module, RAM40964::DATA3_PARAM));
-		addParam(createParamCentered<CKSSThree>(mm2px(Vec(100.538, 109.576)), module, RAM40964::INCREMENT_PARAM));
-		addParam(createParamCentered<CKSSThree>(mm2px(Vec(106.008, 109.576)), module, RAM40964::DISPMODE_PARAM));
-		addParam(createParamCentered<Trimpot>(mm2px(Vec(88.9, 107.43)), module, RAM40964::BRIGHTNESS_PARAM));
-		addParam(createParamCentered<CKSS>(mm2px(Vec(98.01, 40.332)), module, RAM40964::WRITE_PARAM));
-		addParam(createParamCentered<CKSS>(mm2px(Vec(63.5, 11.786)), module, RAM40964::MONITOR_PARAM));
-		addParam(createParamCentered<CKSSWithLine>(mm2px(Vec(82.2, 10.6275)), module, RAM40964::PHASOR_TO_ADDR_PARAM));
-		addParam(createParamCentered<MomentaryVariant<CKSS>>(mm2px(Vec(102.65, 40.332)), module, RAM40964::CLEAR_PARAM));
-		addParam(createParamCentered<CKSSThree>(mm2px(Vec(114.1, 59.276)), module, RAM40964::WRITE0_PARAM));
-		addParam(createParamCentered<CKSSThree>(mm2px(Vec(114.1, 71.976)), module, RAM40964::WRITE1_PARAM));
-		addParam(createParamCentered<CKSSThree>(mm2px(Vec(114.1, 84.676)), module, RAM40964::WRITE2_PARAM));
-		addParam(createParamCentered<CKSSThree>(mm2px(Vec(114.1, 97.376)), module, RAM40964::WRITE3_PARAM));
-
-		addInput(createInputCentered<CL1362Port>(mm2px(Vec(109.22, 10.91)), module, RAM40964::X_INPUT));
-		addInput(createInputCentered<CL1362Port>(mm2px(Vec(109.22, 23.61)), module, RAM40964::Y_INPUT));
-		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(91.44, 40.332)), module, RAM40964::WRITE_INPUT));
-		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(109.22, 40.332)), module, RAM40964::CLEAR_INPUT));
-		addInput(createInputCentered<PJ3410Port>(mm2px(Vec(89.323, 59.276)), module, RAM40964::DATA0_INPUT));
-		addInput(createInputCentered<PJ3410Port>(mm2px(Vec(89.323, 71.976)), module, RAM40964::DATA1_INPUT));
-		addInput(createInputCentered<PJ3410Port>(mm2px(Vec(89.323, 84.676)), module, RAM40964::DATA2_INPUT));
-		addInput(createInputCentered<PJ3410Port>(mm2px(Vec(89.323, 97.376)), module, RAM40964::DATA3_INPUT));
-		addInput(createInputCentered<CL1362Port>(mm2px(Vec(91.44, 10.91)), module, RAM40964::XW_INPUT));
-		addInput(createInputCentered<CL1362Port>(mm2px(Vec(91.44, 23.61)), module, RAM40964::YW_INPUT));
-		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(74.718, 10.91)), module, RAM40964::PHASOR_INPUT));
-
-		addOutput(createOutputCentered<PJ3410Port>(mm2px(Vec(106.8, 59.276)), module, RAM40964::DATA0_OUTPUT));
-		addOutput(createOutputCentered<PJ3410Port>(mm2px(Vec(106.8, 71.976)), module, RAM40964::DATA1_OUTPUT));
-		addOutput(createOutputCentered<PJ3410Port>(mm2px(Vec(106.8, 84.676)), module, RAM40964::DATA2_OUTPUT));
-		addOutput(createOutputCentered<PJ3410Port>(mm2px(Vec(106.8, 97.376)), module, RAM40964::DATA3_OUTPUT));
-		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(69.638, 23.61)), module, RAM40964::X_OUTPUT));
-		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(79.798, 23.61)), module, RAM40964::Y_OUTPUT));
+		addParam(createParamCentered<Rogan1PYellow>(mm2px(Vec(7.62, 10.91)), module, ModuleType::X_PARAM));
+		addParam(createParamCentered<Rogan1PPurple>(mm2px(Vec(7.62, 23.61)), module, ModuleType::Y_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(97.655, 60.816)), module, ModuleType::DATA0_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(97.655, 73.516)), module, ModuleType::DATA1_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(97.655, 86.216)), module, ModuleType::DATA2_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(97.655, 98.916)), module, ModuleType::DATA3_PARAM));
+		addParam(createParamCentered<CKSSThree>(mm2px(Vec(100.538, 109.576)), module, ModuleType::INCREMENT_PARAM));
+		addParam(createParamCentered<CKSSThree>(mm2px(Vec(106.008, 109.576)), module, ModuleType::DISPMODE_PARAM));
+		addParam(createParamCentered<Trimpot>(mm2px(Vec(88.9, 107.43)), module, ModuleType::BRIGHTNESS_PARAM));
+		addParam(createParamCentered<CKSS>(mm2px(Vec(98.01, 40.332)), module, ModuleType::WRITE_PARAM));
+		addParam(createParamCentered<CKSS>(mm2px(Vec(63.5, 11.786)), module, ModuleType::MONITOR_PARAM));
+		addParam(createParamCentered<CKSSWithLine>(mm2px(Vec(82.2, 10.6275)), module, ModuleType::PHASOR_TO_ADDR_PARAM));
+		addParam(createParamCentered<MomentaryVariant<CKSS>>(mm2px(Vec(102.65, 40.332)), module, ModuleType::CLEAR_PARAM));
+		addParam(createParamCentered<CKSSThree>(mm2px(Vec(114.1, 59.276)), module, ModuleType::WRITE0_PARAM));
+		addParam(createParamCentered<CKSSThree>(mm2px(Vec(114.1, 71.976)), module, ModuleType::WRITE1_PARAM));
+		addParam(createParamCentered<CKSSThree>(mm2px(Vec(114.1, 84.676)), module, ModuleType::WRITE2_PARAM));
+		addParam(createParamCentered<CKSSThree>(mm2px(Vec(114.1, 97.376)), module, ModuleType::WRITE3_PARAM));
+
+		addInput(createInputCentered<CL1362Port>(mm2px(Vec(109.22, 10.91)), module, ModuleType::X_INPUT));
+		addInput(createInputCentered<CL1362Port>(mm2px(Vec(109.22, 23.61)), module, ModuleType::Y_INPUT));
+		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(91.44, 40.332)), module, ModuleType::WRITE_INPUT));
+		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(109.22, 40.332)), module, ModuleType::CLEAR_INPUT));
+		addInput(createInputCentered<PJ3410Port>(mm2px(Vec(89.323, 59.276)), module, ModuleType::DATA0_INPUT));
+		addInput(createInputCentered<PJ3410Port>(mm2px(Vec(89.323, 71.976)), module, ModuleType::DATA1_INPUT));
+		addInput(createInputCentered<PJ3410Port>(mm2px(Vec(89.323, 84.676)), module, ModuleType::DATA2_INPUT));
+		addInput(createInputCentered<PJ3410Port>(mm2px(Vec(89.323, 97.376)), module, ModuleType::DATA3_INPUT));
+		addInput(createInputCentered<CL1362Port>(mm2px(Vec(91.44, 10.91)), module, ModuleType::XW_INPUT));
+		addInput(createInputCentered<CL1362Port>(mm2px(Vec(91.44, 23.61)), module, ModuleType::YW_INPUT));
+		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(74.718, 10.91)), module, ModuleType::PHASOR_INPUT));
+
+		addOutput(createOutputCentered<PJ3410Port>(mm2px(Vec(106.8, 59.276)), module, ModuleType::DATA0_OUTPUT));
+		addOutput(createOutputCentered<PJ3410Port>(mm2px(Vec(106.8, 71.976)), module, ModuleType::DATA1_OUTPUT));
+		addOutput(createOutputCentered<PJ3410Port>(mm2px(Vec(106.8, 84.676)), module, ModuleType::DATA2_OUTPUT));
+		addOutput(createOutputCentered<PJ3410Port>(mm2px(Vec(106.8, 97.376)), module, ModuleType::DATA3_OUTPUT));
+		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(69.638, 23.61)), module, ModuleType::X_OUTPUT));
+		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(79.798, 23.61)), module, ModuleType::Y_OUTPUT));
 
 		for (int i=0; i<PORT_MAX_CHANNELS; ++i) {
 			float x = 16.0 + 2.8*i;
-			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 7.5)), module, RAM40964::CH_PLANE0_LIGHTS_G+2*i));
-			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 12.5)), module, RAM40964::CH_PLANE1_LIGHTS_G+2*i));
-			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 17.5)), module, RAM40964::CH_PLANE2_LIGHTS_G+2*i));
-			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 22.5)), module, RAM40964::CH_PLANE3_LIGHTS_G+2*i));
-			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 27.5)), module, RAM40964::CH_RW_LIGHTS_G+2*i));
+			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 7.5)), module, ModuleType::CH_PLANE0_LIGHTS_G+2*i));
+			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 12.5)), module, ModuleType::CH_PLANE1_LIGHTS_G+2*i));
+			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 17.5)), module, ModuleType::CH_PLANE2_LIGHTS_G+2*i));
+			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 22.5)), module, ModuleType::CH_PLANE3_LIGHTS_G+2*i));
+			addChild(createLightCentered<SmallLight<GreenRedLight>>(mm2px(Vec(x, 27.5)), module, ModuleType::CH_RW_LIGHTS_G+2*i));
 		}
-		addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(100.271, 56.236)), module, RAM40964::DATA0_LIGHT));
-		addChild(createLightCentered<MediumLight<GreenLight>>(mm2px(Vec(100.271, 68.936)), module, RAM40964::DATA1_LIGHT));
-		addChild(createLightCentered<MediumLight<BlueLight>>(mm2px(Vec(100.271, 81.636)), module, RAM40964::DATA2_LIGHT));
-		addChild(createLightCentered<MediumLight<YellowLight>>(mm2px(Vec(100.271, 94.336)), module, RAM40964::DATA3_LIGHT));
-		addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(98.66, 47.0)), module, RAM40964::WRITE_LIGHT));
-		addChild(createLightCentered<SmallLight<GreenRedLight>>(Vec(8.0, 8.0), module, RAM40964::DMA_LIGHT_G));
-		addChild(createLightCentered<MediumLight<GreenLight>>(mm2px(Vec(82.2, 5.5)), module, RAM40964::PHASOR_ADDR_LIGHT));
-
-		addChild(createLightMatrix<TinySimpleLight<TrueRGBLight>>(mm2px(Vec(3.54, 42.39)), mm2px(Vec(79.28, 79.28)), module, RAM40964::MATRIX_LIGHT_START, RAM40964::MATRIX_WIDTH, RAM40964::MATRIX_HEIGHT));
+		addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(100.271, 56.236)), module, ModuleType::DATA0_LIGHT));
+		addChild(createLightCentered<MediumLight<GreenLight>>(mm2px(Vec(100.271, 68.936)), module, ModuleType::DATA1_LIGHT));
+		addChild(createLightCentered<MediumLight<BlueLight>>(mm2px(Vec(100.271, 81.636)), module, ModuleType::DATA2_LIGHT));
+		addChild(createLightCentered<MediumLight<YellowLight>>(mm2px(Vec(100.271, 94.336)), module, ModuleType::DATA3_LIGHT));
+		addChild(createLightCentered<MediumLight<RedLight>>(mm2px(Vec(98.66, 47.0)), module, ModuleType::WRITE_LIGHT));
+		addChild(createLightCentered<SmallLight<GreenRedLight>>(Vec(8.0, 8.0), module, ModuleType::DMA_LIGHT_G));
+		addChild(createLightCentered<MediumLight<GreenLight>>(mm2px(Vec(82.2, 5.5)), module, ModuleType::PHASOR_ADDR_LIGHT));
+
+		const Vec offset = mm2px(Vec(LightSizingInfo<TLight>::offset, LightSizingInfo<TLight>::offset));
+		addChild(createLightMatrix<TLight<TrueRGBLight>>(mm2px(Vec(3.54, 42.39))+offset, mm2px(Vec(79.28, 79.28))-2*offset, module, ModuleType::MATRIX_LIGHT_START, ModuleType::DISPLAY_WIDTH, ModuleType::DISPLAY_HEIGHT));
+	}
+
+	void step() override {
+		ModuleWidget::step();
+		if (module)
+			pushDMAUndoSteps<float>(module);
 	}
 
 	void appendContextMenu(Menu* menu) override {
-		auto module = dynamic_cast<RAM40964*>(this->module);
+		auto module = dynamic_cast<ModuleType*>(this->module);
 		menu->addChild(new MenuEntry);
 		menu->addChild(createBoolPtrMenuItem("Fade lights", "", &module->fade_lights));
 		menu->addChild(createBoolPtrMenuItem("Save memory contents", "", &module->save_memory));
+		menu->addChild(createBoolPtrMenuItem("Save memory as 16-bit floats", "", &module->save_float16));
+		appendDMAProfileMenu(menu, module);
 	}
 };
 
 
-Model* modelRAM40964 = createModel<RAM40964, RAM40964Widget>("RAM40964");
+Model* modelRAM2564 = createModel<RAM<16, 16>, RAMWidget<16, 16, MediumLight>>("RAM2564");
+Model* modelRAM40964 = createModel<RAM<64, 64>, RAMWidget<64, 64>>("RAM40964");
+Model* modelRAM163844 = createModel<RAM<128, 128>, RAMWidget<128, 128>>("RAM163844");
+Model* modelRAM655364 = createModel<RAM<256, 256>, RAMWidget<256, 256>>("RAM655364");
@@ -196,15 +196,6 @@ struct RGBMatrix : Module {
 	}
 };
 
-template <template <typename T> typename TLight>
-struct LightSizingInfo {
-	static constexpr double offset = 0.0;
-};
-template <>
-struct LightSizingInfo<LargeLight> {
-	static constexpr double offset = 2.0;
-};
-
 template <int Width, int Height, template <typename T> typename TLight = SmallLight, int PolyChannels = PORT_MAX_CHANNELS>
 struct RGBMatrixWidget : ModuleWidget {
 	using ModuleType = RGBMatrix<Width, Height, PolyChannels>;
@@ -0,0 +1,128 @@
+#include "plugin.hpp"
+#include "DMA.hpp"
+#include "Widgets.hpp"
+
+using namespace sparkette;
+
+// A 4096x4096 address space for DMA clients that only takes up memory where something
+// has been written. Contents aren't saved with the patch.
+struct SparseRAM : DMAHostModule<float> {
+	static constexpr int MEMORY_WIDTH = 4096;
+	static constexpr int MEMORY_HEIGHT = 4096;
+	static constexpr std::size_t PAGE_BITS = 12; // A row per page
+	static constexpr int PAGE_COUNT = (MEMORY_WIDTH * MEMORY_HEIGHT) >> PAGE_BITS;
+
+	enum ParamId {
+		WRITE_ENABLE_PARAM,
+		CLEAR_PARAM,
+		PARAMS_LEN
+	};
+	enum InputId {
+		CLEAR_INPUT,
+		INPUTS_LEN
+	};
+	enum OutputId {
+		USED_OUTPUT,
+		OUTPUTS_LEN
+	};
+	enum LightId {
+		DMA_LIGHT,
+		LIGHTS_LEN
+	};
+
+	DMASparseChannel<float, PAGE_BITS> dma;
+	DMACommandQueue<float> dma_queue;
+	dsp::SchmittTrigger clear_trigger;
+	std::atomic<std::size_t> memory_used{0}; // Bytes, for the display
+
+	SparseRAM() {
+		dma.setup(this, MEMORY_WIDTH, MEMORY_HEIGHT);
+		config(PARAMS_LEN, INPUTS_LEN, OUTPUTS_LEN, LIGHTS_LEN);
+		configSwitch(WRITE_ENABLE_PARAM, 0.f, 1.f, 1.f, "Write enable", {"Read only", "Writable"});
+		configButton(CLEAR_PARAM, "Clear memory");
+		configInput(CLEAR_INPUT, "Clear trigger");
+		configOutput(USED_OUTPUT, "Share of pages in use (0-10V)");
+		dmaClientLightID = DMA_LIGHT;
+	}
+
+	void onReset(const ResetEvent& e) override {
+		dma.clear();
+	}
+
+	void process(const ProcessArgs& args) override {
+		dma_queue.apply(args.frame, getDMAGeneration());
+		dma.reclaim(args.frame);
+		dma.setWriteEnable(params[WRITE_ENABLE_PARAM].getValue() > 0.5f);
+		if (clear_trigger.process(inputs[CLEAR_INPUT].getVoltage() + params[CLEAR_PARAM].getValue()))
+			dma.clear();
+		outputs[USED_OUTPUT].setVoltage(10.f * dma.getPopulatedPageCount() / PAGE_COUNT);
+		memory_used.store(dma.getMemoryUsage(), std::memory_order_relaxed);
+	}
+
+	int getDMAChannelCount() const override {
+		return 1;
+	}
+
+	DMAChannel<float> *getDMAChannel(int num) override {
+		return (num == 0) ? &dma : nullptr;
+	}
+
+	DMACommandQueue<float> *getDMACommandQueue() override {
+		return &dma_queue;
+	}
+
+	// Clients wait on queued commands being applied, so this carries on while bypassed.
+	void processBypass(const ProcessArgs& args) override {
+		dma_queue.apply(args.frame, getDMAGeneration());
+		dma.reclaim(args.frame);
+	}
+};
+
+
+struct SparseRAMWidget : ModuleWidget {
+	GlowingWidget<Label> *used_disp;
+
+	SparseRAMWidget(SparseRAM* module) {
+		setModule(module);
+		setPanel(createPanel(asset::plugin(pluginInstance, "res/SparseRAM.svg")));
+
+		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, 0)));
+		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, 0)));
+		addChild(createWidget<ScrewSilver>(Vec(RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+		addChild(createWidget<ScrewSilver>(Vec(box.size.x - 2 * RACK_GRID_WIDTH, RACK_GRID_HEIGHT - RACK_GRID_WIDTH)));
+
+		addParam(createParamCentered<CKSS>(mm2px(Vec(15.24, 71.0)), module, SparseRAM::WRITE_ENABLE_PARAM));
+		addParam(createParamCentered<VCVButton>(mm2px(Vec(21.59, 90.5)), module, SparseRAM::CLEAR_PARAM));
+
+		addInput(createInputCentered<PJ301MPort>(mm2px(Vec(8.89, 90.5)), module, SparseRAM::CLEAR_INPUT));
+
+		addOutput(createOutputCentered<PJ301MPort>(mm2px(Vec(15.24, 50.5)), module, SparseRAM::USED_OUTPUT));
+
+		addChild(createLightCentered<SmallLight<BlueLight>>(Vec(8.0, 8.0), module, SparseRAM::DMA_LIGHT));
+
+		used_disp = createWidget<GlowingWidget<Label>>(mm2px(Vec(4.5, 25.5)));
+		used_disp->text = "0 kB";
+		used_disp->box.size = mm2px(Vec(21.48, 6.0));
+		used_disp->alignment = Label::CENTER_ALIGNMENT;
+		used_disp->color = componentlibrary::SCHEME_BLUE;
+		used_disp->fontSize = 12.f;
+		addChild(used_disp);
+	}
+
+	void step() override {
+		ModuleWidget::step();
+		if (module) {
+			auto m = dynamic_cast<SparseRAM*>(module);
+			double kb = m->memory_used.load(std::memory_order_relaxed) / 1024.0;
+			used_disp->text = (kb < 1024.0) ? string::f("%.0f kB", kb) : string::f("%.1f MB", kb / 1024.0);
+		}
+	}
+
+	void appendContextMenu(Menu* menu) override {
+		if (module)
+			appendDMAProfileMenu(menu, module);
+	}
+};
+
+
+Model* modelSparseRAM = createModel<SparseRAM, SparseRAMWidget>("SparseRAM");
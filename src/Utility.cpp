@@ -1,4 +1,5 @@
 #include "Utility.hpp"
+#include <cstring>
 
 namespace sparkette {
 
@@ -101,4 +102,147 @@ namespace sparkette {
 				addresses[i] %= matrix_width*matrix_height;
 		}
 	}
+
+	uint16_t floatToHalf(float value) {
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof bits);
+		uint16_t sign = (bits >> 16) & 0x8000;
+		bits &= 0x7fffffff;
+		if (bits >= 0x7f800000) // Infinity or NaN
+			return sign | 0x7c00 | (bits > 0x7f800000 ? 0x200 : 0);
+		if (bits >= 0x477ff000) // Rounds past the largest half
+			return sign | 0x7c00;
+		uint32_t half, rest, tie;
+		if (bits < 0x38800000) { // Subnormal as a half
+			if (bits <= 0x33000000)
+				return sign;
+			uint32_t mantissa = (bits & 0x7fffff) | 0x800000;
+			int shift = 126 - (int)(bits >> 23);
+			half = mantissa >> shift;
+			rest = mantissa & ((1u << shift) - 1);
+			tie = 1u << (shift - 1);
+		} else {
+			half = (bits - 0x38000000) >> 13;
+			rest = bits & 0x1fff;
+			tie = 0x1000;
+		}
+		if (rest > tie || (rest == tie && (half & 1)))
+			++half; // Round to nearest even; a carry moves into the exponent as it should
+		return sign | (uint16_t)half;
+	}
+
+	float halfToFloat(uint16_t value) {
+		uint32_t sign = (uint32_t)(value & 0x8000) << 16;
+		uint32_t exponent = (value >> 10) & 0x1f;
+		uint32_t mantissa = value & 0x3ff;
+		uint32_t bits;
+		if (exponent == 0x1f) {
+			bits = sign | 0x7f800000 | (mantissa << 13);
+		} else if (exponent) {
+			bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+		} else {
+			float magnitude = mantissa * (1.f / 16777216.f);
+			return sign ? -magnitude : magnitude;
+		}
+		float result;
+		std::memcpy(&result, &bits, sizeof result);
+		return result;
+	}
+
+	// The packed form is a series of runs, each a varint holding the run length shifted
+	// left by one, with the low bit set for a repeat. A repeat is followed by one value and
+	// a literal run by all of its values, each 4 or 2 bytes little-endian.
+	static const std::size_t MIN_REPEAT = 3;
+
+	static uint32_t packedWord(float value, bool half) {
+		if (half)
+			return floatToHalf(value);
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof bits);
+		return bits;
+	}
+
+	static float unpackedWord(uint32_t word, bool half) {
+		if (half)
+			return halfToFloat((uint16_t)word);
+		float value;
+		std::memcpy(&value, &word, sizeof value);
+		return value;
+	}
+
+	static void putVarint(std::vector<uint8_t> &out, std::size_t value) {
+		for (; value >= 0x80; value >>= 7)
+			out.push_back((uint8_t)(value | 0x80));
+		out.push_back((uint8_t)value);
+	}
+
+	static bool getVarint(const uint8_t *&in, const uint8_t *end, std::size_t &value) {
+		value = 0;
+		for (int shift=0; in < end && shift < 64; shift += 7) {
+			uint8_t byte = *in++;
+			value |= (std::size_t)(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	static void putWords(std::vector<uint8_t> &out, const uint32_t *words, std::size_t n, bool half) {
+		int width = half ? 2 : 4;
+		for (std::size_t i=0; i<n; ++i)
+			for (int b=0; b<width; ++b)
+				out.push_back((uint8_t)(words[i] >> (8 * b)));
+	}
+
+	void packFloats(std::vector<uint8_t> &out, const float *values, std::size_t n, std::size_t stride, bool half) {
+		std::vector<uint32_t> words(n);
+		for (std::size_t i=0; i<n; ++i)
+			words[i] = packedWord(values[i * stride], half);
+		std::size_t literal = 0;
+		for (std::size_t i=0; i<n; ) {
+			std::size_t run = 1;
+			while (i + run < n && words[i + run] == words[i])
+				++run;
+			if (run >= MIN_REPEAT) {
+				if (i > literal) {
+					putVarint(out, (i - literal) << 1);
+					putWords(out, &words[literal], i - literal, half);
+				}
+				putVarint(out, (run << 1) | 1);
+				putWords(out, &words[i], 1, half);
+				literal = i + run;
+			}
+			i += run;
+		}
+		if (n > literal) {
+			putVarint(out, (n - literal) << 1);
+			putWords(out, &words[literal], n - literal, half);
+		}
+	}
+
+	std::size_t unpackFloats(const uint8_t *in, std::size_t size, float *values, std::size_t n, std::size_t stride, bool half) {
+		const uint8_t *start = in, *end = in + size;
+		std::size_t width = half ? 2 : 4;
+		for (std::size_t i=0; i<n; ) {
+			std::size_t token;
+			if (!getVarint(in, end, token))
+				return 0;
+			bool repeat = token & 1;
+			std::size_t run = token >> 1;
+			if (run == 0 || run > n - i || (std::size_t)(end - in) < (repeat ? 1 : run) * width)
+				return 0;
+			for (std::size_t j=0; j<run; ++j) {
+				if (!repeat || j == 0) {
+					uint32_t word = 0;
+					for (std::size_t b=0; b<width; ++b)
+						word |= (uint32_t)*in++ << (8 * b);
+					values[i * stride] = unpackedWord(word, half);
+				} else {
+					values[i * stride] = values[(i - 1) * stride];
+				}
+				++i;
+			}
+		}
+		return in - start;
+	}
 }
@@ -21,4 +21,14 @@ namespace sparkette {
 
 	void fillAddressArray(int xoff, int yoff, int x_nchan, int y_nchan, const float *x_array, const float *y_array, int *addresses, int poly_increment, int matrix_width, int matrix_height);
 
+	uint16_t floatToHalf(float value);
+	float halfToFloat(uint16_t value);
+
+	// Compact binary form of a block of floats for saving in patches (as base64), as 32-bit
+	// floats or rounded to 16-bit ones. Runs of equal values, such as cleared memory, are
+	// stored once with a count. Values are read at values[i * stride].
+	void packFloats(std::vector<uint8_t> &out, const float *values, std::size_t n, std::size_t stride, bool half);
+	// Returns the number of bytes used, or 0 if they don't hold exactly n values.
+	std::size_t unpackFloats(const uint8_t *in, std::size_t size, float *values, std::size_t n, std::size_t stride, bool half);
+
 }
@@ -23,12 +23,17 @@ void init(Plugin* p) {
 	p->addModel(modelIntegrator);
 	p->addModel(modelColorMixer);
 	p->addModel(modelBusybox);
+	p->addModel(modelRAM2564);
 	p->addModel(modelRAM40964);
+	p->addModel(modelRAM163844);
+	p->addModel(modelRAM655364);
 	p->addModel(modelQuadrants);
 	p->addModel(modelVoltageRange);
 	p->addModel(modelMicrocosm);
 	p->addModel(modelDMAFX);
 	p->addModel(modelAccessor);
+	p->addModel(modelDMABridge);
+	p->addModel(modelSparseRAM);
 
 	// Any other plugin initialization may go here.
 	// As an alternative, consider lazy-loading assets and lookup tables when your module is created to reduce startup times of Rack.
@@ -23,9 +23,14 @@ extern Model* modelPolyCat;
 extern Model* modelIntegrator;
 extern Model* modelColorMixer;
 extern Model* modelBusybox;
+extern Model* modelRAM2564;
 extern Model* modelRAM40964;
+extern Model* modelRAM163844;
+extern Model* modelRAM655364;
 extern Model* modelQuadrants;
 extern Model* modelVoltageRange;
 extern Model* modelMicrocosm;
 extern Model* modelDMAFX;
 extern Model* modelAccessor;
+extern Model* modelDMABridge;
+extern Model* modelSparseRAM;